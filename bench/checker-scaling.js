@@ -0,0 +1,69 @@
+#!/usr/bin/env node
+
+/**
+ * Type checker scaling benchmark
+ *
+ * Type checks programs with 1000 to 16000 top-level lets and reports the
+ * cost per binding, and the exponent k in time ~ lets^k fitted between the
+ * smallest and largest size. Linear checking gives k close to 1 (a little
+ * above, as garbage collection gets slower with a larger heap); a checker
+ * that rescans the environment on every let gives k close to 2. The run
+ * fails if k exceeds MAX_EXPONENT.
+ *
+ * Usage:
+ *   npm run build && node bench/checker-scaling.js
+ */
+
+import { tokenize, parse, typeCheck } from '../dist/index.js';
+
+const SIZES = [1000, 2000, 4000, 8000, 16000];
+const MAX_EXPONENT = 1.5;
+
+function generateSource(lets) {
+  const parts = ['let f_0 = (x) => x + 1'];
+  for (let i = 1; i < lets; i++) {
+    if (i % 2 === 0) {
+      parts.push(`let f_${i} = (x) => if x > ${i} then f_${i - 1}(x) else x * 2`);
+    } else {
+      parts.push(`let f_${i} = (x) => { value: f_${i - 1}(x), tag: "t${i}" }.value`);
+    }
+  }
+  return parts.join('\n') + '\n';
+}
+
+function measure(program) {
+  typeCheck(program); // warm up
+
+  // Best of several runs: other load on the machine only ever adds time
+  let best = Infinity;
+  for (let i = 0; i < 5; i++) {
+    const start = performance.now();
+    const { errors } = typeCheck(program);
+    best = Math.min(best, performance.now() - start);
+    if (errors.length > 0) {
+      console.error(`FAIL: generated program has type errors: ${errors[0].message}`);
+      process.exit(1);
+    }
+  }
+  return best;
+}
+
+const times = [];
+console.log('lets        time (ms)   us/let');
+for (const lets of SIZES) {
+  const { program } = parse(tokenize(generateSource(lets)).tokens);
+  const elapsed = measure(program);
+  times.push(elapsed);
+  console.log(
+    `${String(lets).padEnd(12)}${elapsed.toFixed(2).padEnd(12)}${((elapsed * 1000) / lets).toFixed(1)}`
+  );
+}
+
+const exponent =
+  Math.log(times[times.length - 1] / times[0]) / Math.log(SIZES[SIZES.length - 1] / SIZES[0]);
+console.log(`\ngrowth exponent: ${exponent.toFixed(2)}`);
+
+if (exponent > MAX_EXPONENT) {
+  console.error(`FAIL: type checking does not scale linearly (exponent > ${MAX_EXPONENT})`);
+  process.exit(1);
+}
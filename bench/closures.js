@@ -0,0 +1,108 @@
+#!/usr/bin/env node
+
+/**
+ * Closure allocation benchmark
+ *
+ * Compiles the benchmark workloads twice, with blocks, matches and provide
+ * expressions lowered to statements where their value is returned or bound
+ * (the default) and with every one of them wrapped in an immediately
+ * invoked closure. For each build it counts the closures invoked in that
+ * way while running the workload once, and times the run.
+ *
+ * Usage:
+ *   npm run build && node bench/closures.js
+ */
+
+import { compile, formatCompilerErrors } from '../dist/index.js';
+import { generateWorkloads } from './generate.js';
+
+const SAMPLES = 9;
+const WARMUP_MS = 200;
+
+/**
+ * Functions whose bodies are blocks of lets ending in a match or provide
+ */
+function generateBlocks(functions = 100) {
+  const range = (n) => Array.from({ length: n }, (_, i) => i);
+  const parts = range(functions).map((i) =>
+    `let step_${i} = (x) => {\n` +
+    `  let doubled = x * 2\n` +
+    `  let bucket = match doubled % 3 {\n` +
+    `    0 => ${i}\n` +
+    `    _ => doubled\n` +
+    `  }\n` +
+    `  provide offset = bucket in { offset + x }\n` +
+    `}`
+  );
+
+  const exports = range(functions).map((i) => `step_${i}`);
+  return {
+    name: 'blocks',
+    source: parts.join('\n\n') + '\n',
+    exports,
+    run: (fns) => {
+      let total = 0;
+      for (const name of exports) {
+        for (let x = 0; x < 100; x++) total += fns[name](x);
+      }
+      return total;
+    },
+  };
+}
+
+/**
+ * Compile a workload with closures counted as they are invoked
+ */
+function build(workload, lowerToStatements) {
+  const compiled = compile(workload.source, { emit: { lowerToStatements } });
+  if (!compiled.success) {
+    console.error(`${workload.name}: generated program does not compile`);
+    console.error(formatCompilerErrors(compiled.errors));
+    process.exit(1);
+  }
+
+  const counter = { closures: 0 };
+  const code = compiled.code.replace(/\(\(\) => \{\n/g, '(() => { __counter.closures++;\n');
+  const exports = new Function(
+    '__counter',
+    `${code}\nreturn { ${workload.exports.join(', ')} };`
+  )(counter);
+
+  workload.run(exports);
+  counter.closures = 0;
+  workload.run(exports);
+  return { closures: counter.closures, run: () => workload.run(exports) };
+}
+
+/**
+ * Best time of one call to `fn`, in milliseconds
+ */
+function best(fn) {
+  const warmupStart = performance.now();
+  while (performance.now() - warmupStart < WARMUP_MS) fn();
+
+  let fastest = Infinity;
+  for (let i = 0; i < SAMPLES; i++) {
+    const start = performance.now();
+    fn();
+    fastest = Math.min(fastest, performance.now() - start);
+  }
+  return fastest;
+}
+
+console.log('workload        closures per run              runtime (ms)');
+console.log('                closures     statements      closures     statements');
+
+const workloads = [...generateWorkloads(), generateBlocks()].filter((w) => w.run);
+for (const workload of workloads) {
+  const before = build(workload, false);
+  const after = build(workload, true);
+
+  console.log(
+    workload.name.padEnd(16) +
+    String(before.closures).padEnd(13) +
+    String(after.closures).padEnd(16) +
+    best(before.run).toFixed(2).padEnd(14) +
+    best(after.run).toFixed(2)
+  );
+}
@@ -0,0 +1,207 @@
+/**
+ * Synthetic Lambdawg program generator for benchmarks
+ *
+ * Each generator returns a workload: the program source, the names the
+ * emitted JavaScript should expose, and a `run` function exercising them
+ * at runtime.
+ */
+
+const range = (n) => Array.from({ length: n }, (_, i) => i);
+
+/**
+ * Functions made of long map/filter pipelines over a list
+ */
+export function generatePipelines(functions = 200, depth = 24) {
+  const parts = [];
+  for (const i of range(functions)) {
+    const stages = range(depth).map((j) => {
+      switch (j % 3) {
+        case 0: return `  |> map((x) => x + ${j + 1}, _)`;
+        case 1: return `  |> filter((x) => x % ${j + 2} != 0, _)`;
+        default: return `  |> map((x) => x * 3 % 1000003, _)`;
+      }
+    });
+    parts.push(`let pipeline_${i} = (xs) => xs\n${stages.join('\n')}\n  |> sum(_)`);
+  }
+
+  const exports = range(functions).map((i) => `pipeline_${i}`);
+  const input = range(1000);
+  return {
+    name: 'pipelines',
+    source: parts.join('\n\n') + '\n',
+    exports,
+    run: (fns) => {
+      let total = 0;
+      for (const name of exports) total += fns[name](input);
+      return total;
+    },
+  };
+}
+
+/**
+ * Many modules, each with a long chain of small bindings
+ */
+export function generateWideModules(modules = 60, width = 80) {
+  const parts = [];
+  for (const i of range(modules)) {
+    const body = [`  let f_0 = (x) => x + ${i}`];
+    for (const j of range(width).slice(1)) {
+      body.push(
+        `  let f_${j} = (x) => if x > 1000 then f_${j - 1}(x - 1000) else f_${j - 1}(x + ${j})`
+      );
+    }
+    parts.push(`module mod_${i} {\n${body.join('\n')}\n}`);
+  }
+
+  const exports = range(modules).map((i) => `mod_${i}`);
+  return {
+    name: 'wide-modules',
+    source: parts.join('\n\n') + '\n',
+    exports,
+    run: (mods) => {
+      let total = 0;
+      for (const name of exports) {
+        const last = mods[name][`f_${width - 1}`];
+        for (let x = 0; x < 200; x++) total += last(x);
+      }
+      return total;
+    },
+  };
+}
+
+/**
+ * Functions with large integer and list match expressions
+ */
+export function generateMatches(functions = 100, arms = 60) {
+  const parts = [];
+  for (const i of range(functions)) {
+    const cases = range(arms).map((j) => `  ${j} => ${(j * 7 + i) % 100}`);
+    parts.push(`let classify_${i} = (n) => match n {\n${cases.join('\n')}\n  _ => -1\n}`);
+    // Only one list arm: a following `[` would continue the previous arm's
+    // body as an index expression
+    parts.push(
+      `let prefix_${i} = (xs) => match xs {\n` +
+      `  [a, b, c, ...rest] => a + b + c + length(rest)\n` +
+      `  other => length(other)\n` +
+      `}`
+    );
+  }
+
+  const inputs = range(8).map((n) => range(n));
+  return {
+    name: 'matches',
+    source: parts.join('\n\n') + '\n',
+    exports: range(functions).flatMap((i) => [`classify_${i}`, `prefix_${i}`]),
+    run: (fns) => {
+      let total = 0;
+      for (const i of range(functions)) {
+        const classify = fns[`classify_${i}`];
+        const prefix = fns[`prefix_${i}`];
+        for (let n = 0; n < arms + 10; n++) total += classify(n);
+        for (const xs of inputs) total += prefix(xs);
+      }
+      return total;
+    },
+  };
+}
+
+/**
+ * Event handlers dispatching on many constructor tags, called with
+ * tagged values built outside the program
+ */
+export function generateEvents(handlers = 50, tags = 24) {
+  const parts = [];
+  for (const i of range(handlers)) {
+    const arms = range(tags).map((j) =>
+      j % 4 === 0
+        ? `  Event${j}(v) if v > ${i} => v - ${j}\n  Event${j}(v) => v + ${j}`
+        : `  Event${j}(v) => v * ${(j % 3) + 1}`
+    );
+    parts.push(`let route_${i} = (event) => match event {\n${arms.join('\n')}\n  _ => 0\n}`);
+  }
+
+  const events = range(1000).map((n) => ({ __tag: `Event${(n * 7) % tags}`, value: n % 100 }));
+  return {
+    name: 'events',
+    source: parts.join('\n\n') + '\n',
+    exports: range(handlers).map((i) => `route_${i}`),
+    run: (fns) => {
+      let total = 0;
+      for (const i of range(handlers)) {
+        const route = fns[`route_${i}`];
+        for (const event of events) total += route(event);
+      }
+      return total;
+    },
+  };
+}
+
+/**
+ * Functions passing the same record shapes around and wrapping them in
+ * Result values
+ */
+export function generateRecords(groups = 300) {
+  const parts = [];
+  for (const i of range(groups)) {
+    parts.push(`let point_${i} = { x: ${i}, y: ${i * 2}, label: "p${i}" }`);
+    parts.push(`let shift_${i} = (p) => { x: p.x + 1, y: p.y + 1, label: p.label }`);
+    parts.push(
+      `let check_${i} = (p) => if p.x > ${i + 100} then Error("out of range") else Ok(shift_${i}(p))`
+    );
+    parts.push(`let moved_${i} = check_${i}(shift_${i}(point_${i}))`);
+  }
+
+  const names = range(groups).flatMap((i) => [`point_${i}`, `check_${i}`]);
+  return {
+    name: 'records',
+    source: parts.join('\n') + '\n',
+    exports: names,
+    run: (fns) => {
+      let ok = 0;
+      for (const i of range(groups)) {
+        const check = fns[`check_${i}`];
+        let point = fns[`point_${i}`];
+        for (let n = 0; n < 50; n++) {
+          const result = check(point);
+          if (result.__tag === 'Ok') {
+            ok++;
+            point = result.value;
+          }
+        }
+      }
+      return ok;
+    },
+  };
+}
+
+/**
+ * Top-level bindings holding big list literals; the runtime cost is
+ * evaluating the program itself
+ */
+export function generateLists(lists = 40, length = 2000) {
+  const parts = [];
+  for (const i of range(lists)) {
+    const elements = range(length).map((j) => (j * 31 + i) % 997);
+    parts.push(`let list_${i} = [${elements.join(', ')}]`);
+    parts.push(`let total_${i} = sum(list_${i})`);
+  }
+
+  const exports = range(lists).map((i) => `total_${i}`);
+  return {
+    name: 'lists',
+    source: parts.join('\n') + '\n',
+    exports,
+    run: null,
+  };
+}
+
+export function generateWorkloads() {
+  return [
+    generatePipelines(),
+    generateWideModules(),
+    generateMatches(),
+    generateEvents(),
+    generateRecords(),
+    generateLists(),
+  ];
+}
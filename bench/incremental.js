@@ -0,0 +1,65 @@
+#!/usr/bin/env node
+
+/**
+ * Incremental parsing benchmark
+ *
+ * Simulates typing in the middle of files of increasing size and compares
+ * the per-keystroke cost of IncrementalParser.edit() with a full
+ * tokenize() + parse() of the updated source.
+ *
+ * Usage:
+ *   npm run build && node bench/incremental.js
+ */
+
+import { tokenize, parse, IncrementalParser } from '../dist/index.js';
+
+const LINE_COUNTS = [1_000, 10_000, 40_000];
+const KEYSTROKES = 200;
+// Full reparses are slow on large inputs; time fewer of them
+const FULL_KEYSTROKES = 20;
+
+function generateSource(lines) {
+  const parts = [];
+  for (let i = 0; parts.length < lines; i++) {
+    parts.push(`let value_${i} = { name: "entry", weight: ${i}, tags: ["a", "b"] }`);
+    parts.push(`let scale_${i} = (x) => if x > ${i} then x * 2 else x`);
+  }
+  return parts.join('\n') + '\n';
+}
+
+console.log('lines       full (ms/key)   incremental (ms/key)   speedup');
+
+for (const lines of LINE_COUNTS) {
+  const source = generateSource(lines);
+  const offset = source.indexOf('\n', source.length >> 1) + 1;
+
+  // Full reparse per keystroke
+  let text = source;
+  let start = performance.now();
+  for (let i = 0; i < FULL_KEYSTROKES; i++) {
+    text = text.slice(0, offset + i) + 'x' + text.slice(offset + i);
+    parse(tokenize(text).tokens);
+  }
+  const full = (performance.now() - start) / FULL_KEYSTROKES;
+  for (let i = FULL_KEYSTROKES; i < KEYSTROKES; i++) {
+    text = text.slice(0, offset + i) + 'x' + text.slice(offset + i);
+  }
+
+  // Incremental reparse per keystroke
+  const parser = new IncrementalParser(source);
+  start = performance.now();
+  for (let i = 0; i < KEYSTROKES; i++) {
+    parser.edit({ start: offset + i, end: offset + i, text: 'x' });
+  }
+  const incremental = (performance.now() - start) / KEYSTROKES;
+
+  if (parser.source !== text) {
+    console.error('FAIL: incremental source diverged from full source');
+    process.exit(1);
+  }
+
+  console.log(
+    `${String(lines).padEnd(12)}${full.toFixed(2).padEnd(16)}` +
+    `${incremental.toFixed(3).padEnd(23)}${(full / incremental).toFixed(0)}x`
+  );
+}
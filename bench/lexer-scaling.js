@@ -0,0 +1,89 @@
+#!/usr/bin/env node
+
+/**
+ * Lexer scaling benchmark
+ *
+ * Tokenizes generated sources from 1 KB to 10 MB and reports the cost per
+ * byte at each size. Tokenization is linear when the per-byte cost stays
+ * flat. A quadratic lexer grows ~10x per byte with every 10x step in input
+ * size, so the run fails if any step grows by more than MAX_STEP_RATIO.
+ *
+ * Usage:
+ *   npm run build && node bench/lexer-scaling.js
+ */
+
+import { tokenize } from '../dist/index.js';
+
+const SIZES = [1e3, 1e4, 1e5, 1e6, 1e7];
+const MAX_STEP_RATIO = 4;
+
+const SNIPPET = [
+  '-- generated config entry',
+  'let entry_N = {',
+  '  name: "service-N",',
+  '  port: 8080,',
+  '  weight: 0.75,',
+  '  tags: ["a", "b", "c"],',
+  '}',
+  'let check_N = (x) => if x > 10 then x |> map((y) => y * 2, _) else [x]',
+  '{- block',
+  '   comment -}',
+  '',
+].join('\n');
+
+function generateSource(bytes) {
+  const parts = [];
+  let size = 0;
+  let i = 0;
+  while (size < bytes) {
+    const chunk = SNIPPET.replace(/_N/g, `_${i}`).replace(/-N"/g, `-${i}"`);
+    parts.push(chunk);
+    size += chunk.length;
+    i++;
+  }
+  return parts.join('');
+}
+
+function measure(source) {
+  // Repeat small inputs so every sample covers at least ~50ms of work
+  const reps = Math.max(1, Math.floor(2e6 / source.length));
+  tokenize(source); // warm up
+
+  const start = process.hrtime.bigint();
+  let tokens = 0;
+  for (let i = 0; i < reps; i++) {
+    tokens = tokenize(source).tokens.length;
+  }
+  const elapsed = Number(process.hrtime.bigint() - start) / 1e6 / reps;
+  return { elapsed, tokens };
+}
+
+function formatBytes(n) {
+  if (n >= 1e6) return `${(n / 1e6).toFixed(0)} MB`;
+  if (n >= 1e3) return `${(n / 1e3).toFixed(0)} KB`;
+  return `${n} B`;
+}
+
+const results = [];
+console.log('size        tokens      time (ms)   ns/byte');
+for (const size of SIZES) {
+  const source = generateSource(size);
+  const { elapsed, tokens } = measure(source);
+  const nsPerByte = (elapsed * 1e6) / source.length;
+  results.push(nsPerByte);
+  console.log(
+    `${formatBytes(size).padEnd(12)}${String(tokens).padEnd(12)}` +
+    `${elapsed.toFixed(2).padEnd(12)}${nsPerByte.toFixed(1)}`
+  );
+}
+
+let worst = 0;
+for (let i = 1; i < results.length; i++) {
+  worst = Math.max(worst, results[i] / results[i - 1]);
+}
+console.log(`\nworst per-byte cost growth per 10x step: ${worst.toFixed(2)}x`);
+
+if (worst > MAX_STEP_RATIO) {
+  console.error(`FAIL: lexer does not scale linearly (step ratio > ${MAX_STEP_RATIO}x)`);
+  process.exit(1);
+}
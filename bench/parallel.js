@@ -0,0 +1,92 @@
+#!/usr/bin/env node
+
+/**
+ * Parallel stage benchmark
+ *
+ * Compiles pipelines with a CPU-heavy and a cheap `@parallel` map stage,
+ * and a heavy one nested in another over groups of 1,000 elements, twice:
+ * once run on the worker pool (the default) and once with parallel stages
+ * disabled. Both are timed over lists of growing length. Lists
+ * shorter than a stage's `minSize` run sequentially in either build, and
+ * with no `chunkSize` the runtime keeps stages too cheap to gain from
+ * workers on the calling thread.
+ *
+ * Usage:
+ *   npm run build && node bench/parallel.js
+ */
+
+import { availableParallelism } from 'node:os';
+import { compile, formatCompilerErrors } from '../dist/index.js';
+
+const SAMPLES = 5;
+const WARMUP_MS = 500;
+const SIZES = [1_000, 10_000, 100_000];
+
+const range = (n) => Array.from({ length: n }, (_, i) => i);
+
+const source =
+  `let steps = [${range(200).map((i) => i + 1).join(', ')}]\n` +
+  `let heavy = (xs) => xs\n` +
+  `  |> @parallel(minSize: 5000) map((x) => fold((acc, s) => (acc * 31 + s + x) % 1000003, 0, steps), _)\n` +
+  `  |> sum(_)\n` +
+  `let cheap = (xs) => xs |> @parallel(minSize: 5000) map((x) => x * 2 + 1, _) |> sum(_)\n` +
+  `let nested = (groups) => groups\n` +
+  `  |> @parallel(minSize: 2) map((xs) => xs\n` +
+  `    |> @parallel(minSize: 500) map((x) => fold((acc, s) => (acc * 31 + s + x) % 1000003, 0, steps), _)\n` +
+  `    |> sum(_), _)\n` +
+  `  |> sum(_)\n`;
+
+function build(parallelStages) {
+  const compiled = compile(source, { parallelStages });
+  if (!compiled.success) {
+    console.error(formatCompilerErrors(compiled.errors));
+    process.exit(1);
+  }
+  return new Function(`${compiled.code}\nreturn { heavy, cheap, nested };`)();
+}
+
+/**
+ * Best time of one call to `fn`, in milliseconds
+ */
+function best(fn) {
+  const warmupStart = performance.now();
+  while (performance.now() - warmupStart < WARMUP_MS) fn();
+
+  let fastest = Infinity;
+  for (let i = 0; i < SAMPLES; i++) {
+    const start = performance.now();
+    fn();
+    fastest = Math.min(fastest, performance.now() - start);
+  }
+  return fastest;
+}
+
+const sequential = build(false);
+const parallel = build(true);
+
+console.log(`${availableParallelism()} cores`);
+console.log('stage   elements      sequential (ms)   parallel (ms)   speedup');
+const inputs = {
+  heavy: range,
+  cheap: range,
+  nested: (size) => range(size / 1000).map((g) => range(1000).map((i) => g * 1000 + i)),
+};
+
+for (const stage of ['heavy', 'cheap', 'nested']) {
+  for (const size of SIZES) {
+    const input = inputs[stage](size);
+    if (sequential[stage](input) !== parallel[stage](input)) {
+      console.error(`${stage} ${size}: parallel result differs`);
+      process.exit(1);
+    }
+    const before = best(() => sequential[stage](input));
+    const after = best(() => parallel[stage](input));
+    console.log(
+      stage.padEnd(8) +
+      String(size).padEnd(14) +
+      before.toFixed(2).padEnd(18) +
+      after.toFixed(2).padEnd(16) +
+      (before / after).toFixed(2) + 'x'
+    );
+  }
+}
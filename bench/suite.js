@@ -0,0 +1,180 @@
+#!/usr/bin/env node
+
+/**
+ * Compiler benchmark suite
+ *
+ * Compiles the synthetic workloads from generate.js and times each phase
+ * (tokenize, parse, typeCheck, emit) as well as the emitted JavaScript.
+ * Every figure is the fastest of several samples taken after a warm-up:
+ * interference from the rest of the machine only ever adds time, so the
+ * minimum is far more repeatable than the mean or median. Fast operations
+ * are repeated within a sample so that each one lasts at least SAMPLE_MS.
+ *
+ * Usage:
+ *   npm run build && node bench/suite.js [options]
+ *
+ * Options:
+ *   --save               Record the results as the baseline
+ *   --compare            Fail if any result regressed against the baseline
+ *   --baseline <file>    Baseline file (default: bench/baseline.json)
+ *   --threshold <ratio>  Allowed slowdown before failing (default: 0.25)
+ *
+ * Baselines are machine-specific: record one on the machine that runs the
+ * comparison, e.g. on the CI runner before the change under test. Shared
+ * runners can slow down for seconds at a time, so a result that looks like
+ * a regression is measured again before it fails the run.
+ */
+
+import { existsSync, readFileSync, writeFileSync } from 'node:fs';
+import { fileURLToPath } from 'node:url';
+import { compile, tokenize, parse, typeCheck, emit, formatCompilerErrors } from '../dist/index.js';
+import { generateWorkloads } from './generate.js';
+
+const SAMPLES = 9;
+const WARMUP_MS = 200;
+const SAMPLE_MS = 50;
+// Differences below this are treated as noise regardless of the ratio
+const NOISE_FLOOR_MS = 0.5;
+// Extra measurements of an apparent regression before reporting it
+const RETRIES = 2;
+const METRICS = ['tokenize', 'parse', 'typeCheck', 'emit', 'runtime'];
+
+const args = process.argv.slice(2);
+const option = (name, fallback) => {
+  const index = args.indexOf(name);
+  return index === -1 ? fallback : args[index + 1];
+};
+const baselineFile = option(
+  '--baseline',
+  fileURLToPath(new URL('./baseline.json', import.meta.url))
+);
+const threshold = Number(option('--threshold', 0.25));
+
+/**
+ * Best time of one call to `fn`, in milliseconds
+ */
+function best(fn) {
+  let calls = 0;
+  const warmupStart = performance.now();
+  while (performance.now() - warmupStart < WARMUP_MS) {
+    fn();
+    calls++;
+  }
+  const iterations = Math.max(1, Math.ceil(SAMPLE_MS / (WARMUP_MS / calls)));
+
+  let fastest = Infinity;
+  for (let i = 0; i < SAMPLES; i++) {
+    const start = performance.now();
+    for (let j = 0; j < iterations; j++) fn();
+    fastest = Math.min(fastest, (performance.now() - start) / iterations);
+  }
+  return fastest;
+}
+
+function instantiate(code, exports) {
+  return new Function(`${code}\nreturn { ${exports.join(', ')} };`)();
+}
+
+/**
+ * Compile a workload and return the operations to time
+ */
+function prepare(workload) {
+  const compiled = compile(workload.source);
+  if (!compiled.success) {
+    console.error(`${workload.name}: generated program does not compile`);
+    console.error(formatCompilerErrors(compiled.errors));
+    process.exit(1);
+  }
+
+  const { tokens } = tokenize(workload.source);
+  const { program } = parse(tokens);
+  const exports = instantiate(compiled.code, workload.exports);
+
+  return {
+    tokenize: () => tokenize(workload.source),
+    parse: () => parse(tokens),
+    typeCheck: () => typeCheck(program),
+    emit: () => emit(program),
+    runtime: workload.run
+      ? () => workload.run(exports)
+      : () => instantiate(compiled.code, workload.exports),
+  };
+}
+
+const throughput = (bytes, ms) => `${(bytes / 1e6 / (ms / 1000)).toFixed(1)} MB/s`;
+
+const operations = {};
+const results = {};
+console.log(
+  'workload        size    tokenize       parse          typeCheck      emit           runtime'
+);
+
+for (const workload of generateWorkloads()) {
+  const ops = prepare(workload);
+  const result = {};
+  for (const metric of METRICS) {
+    result[metric] = best(ops[metric]);
+  }
+  operations[workload.name] = ops;
+  results[workload.name] = result;
+
+  const bytes = workload.source.length;
+  console.log(
+    workload.name.padEnd(16) +
+    `${(bytes / 1024).toFixed(0)} KB`.padEnd(8) +
+    ['tokenize', 'parse', 'typeCheck', 'emit']
+      .map((phase) => throughput(bytes, result[phase]).padEnd(15))
+      .join('') +
+    `${result.runtime.toFixed(2)} ms`
+  );
+}
+
+if (args.includes('--save')) {
+  const baseline = { node: process.version, date: new Date().toISOString(), results };
+  writeFileSync(baselineFile, JSON.stringify(baseline, null, 2) + '\n');
+  console.log(`\nBaseline written to ${baselineFile}`);
+}
+
+if (args.includes('--compare')) {
+  if (!existsSync(baselineFile)) {
+    console.error(`\nNo baseline at ${baselineFile}; record one with --save`);
+    process.exit(1);
+  }
+
+  const baseline = JSON.parse(readFileSync(baselineFile, 'utf-8'));
+  console.log(`\nCompared with baseline from ${baseline.date} (${baseline.node}):`);
+
+  let regressions = 0;
+  for (const [name, result] of Object.entries(results)) {
+    const before = baseline.results[name];
+    if (!before) continue;
+
+    for (const metric of METRICS) {
+      const then = before[metric];
+      const regressedFrom = (time) =>
+        time / then > 1 + threshold && time - then > NOISE_FLOOR_MS;
+
+      let now = result[metric];
+      for (let i = 0; i < RETRIES && regressedFrom(now); i++) {
+        now = Math.min(now, best(operations[name][metric]));
+      }
+      const regressed = regressedFrom(now);
+      if (regressed) regressions++;
+
+      const ratio = now / then;
+      const change = `${ratio >= 1 ? '+' : ''}${((ratio - 1) * 100).toFixed(1)}%`;
+      console.log(
+        `  ${`${name}/${metric}`.padEnd(26)}` +
+        `${then.toFixed(2).padStart(10)} ms -> ` +
+        `${now.toFixed(2).padStart(10)} ms  ${change.padStart(8)}` +
+        (regressed ? '  REGRESSION' : '')
+      );
+    }
+  }
+
+  if (regressions > 0) {
+    console.error(`\n${regressions} result(s) regressed by more than ${(threshold * 100).toFixed(0)}%`);
+    process.exit(1);
+  }
+  console.log('\nNo regressions');
+}
@@ -0,0 +1,98 @@
+#!/usr/bin/env node
+
+/**
+ * Token storage benchmark
+ *
+ * Compares the default Token[] lexer output with the packed TokenBuffer:
+ * heap retained by the token stream, time to lex and parse, and the number
+ * and duration of garbage collections observed while doing so.
+ *
+ * Usage:
+ *   npm run build && node --expose-gc bench/token-memory.js [sizeInMB]
+ */
+
+import { PerformanceObserver } from 'node:perf_hooks';
+import { tokenize, tokenizeCompact, parse } from '../dist/index.js';
+
+if (typeof globalThis.gc !== 'function') {
+  console.error('Run with --expose-gc to get stable heap measurements');
+  process.exit(1);
+}
+
+const sizeMB = Number(process.argv[2] ?? 5);
+
+const SNIPPET = [
+  'let entry_N = {',
+  '  name: "service",',
+  '  port: 8080,',
+  '  tags: ["a", "b", "c"],',
+  '}',
+  'let check_N = (x) => if x > 10 then x |> map((y) => y * 2, _) else [x]',
+  '',
+].join('\n');
+
+function generateSource(bytes) {
+  const parts = [];
+  let size = 0;
+  for (let i = 0; size < bytes; i++) {
+    const chunk = SNIPPET.replace(/_N/g, `_${i}`);
+    parts.push(chunk);
+    size += chunk.length;
+  }
+  return parts.join('');
+}
+
+let gcCount = 0;
+let gcTime = 0;
+const observer = new PerformanceObserver((list) => {
+  for (const entry of list.getEntries()) {
+    gcCount++;
+    gcTime += entry.duration;
+  }
+});
+observer.observe({ entryTypes: ['gc'] });
+
+function flushObserver() {
+  // GC entries are delivered asynchronously
+  return new Promise((resolve) => setTimeout(resolve, 50));
+}
+
+async function run(label, lex) {
+  globalThis.gc();
+  await flushObserver();
+  gcCount = 0;
+  gcTime = 0;
+
+  const heapBefore = process.memoryUsage().heapUsed;
+  const lexStart = performance.now();
+  const stream = lex();
+  const lexTime = performance.now() - lexStart;
+
+  // This forced collection is counted too; it is subtracted when reporting
+  globalThis.gc();
+  const retained = process.memoryUsage().heapUsed - heapBefore;
+
+  const parseStart = performance.now();
+  const { program } = parse(stream);
+  const parseTime = performance.now() - parseStart;
+  await flushObserver();
+
+  console.log(
+    `${label.padEnd(14)}` +
+    `${(retained / 1e6).toFixed(1).padStart(10)} MB` +
+    `${lexTime.toFixed(0).padStart(10)} ms` +
+    `${parseTime.toFixed(0).padStart(10)} ms` +
+    `${String(gcCount - 1).padStart(8)}` +
+    `${gcTime.toFixed(0).padStart(10)} ms` +
+    `   (${program.statements.length} statements)`
+  );
+}
+
+const source = generateSource(sizeMB * 1e6);
+console.log(`source: ${(source.length / 1e6).toFixed(1)} MB\n`);
+console.log('mode          token heap       lex     parse     GCs   GC time');
+
+await run('Token[]', () => tokenize(source).tokens);
+await run('TokenBuffer', () => tokenizeCompact(source).buffer);
+
+observer.disconnect();
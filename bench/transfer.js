@@ -0,0 +1,78 @@
+#!/usr/bin/env node
+
+/**
+ * Numeric list transfer benchmark
+ *
+ * Times what it costs to hand a list of 10M floats to the worker pool and
+ * take the results back: as a plain list, serialized on one side and
+ * deserialized on the other in each direction, and as a list the checker
+ * proved to hold numbers, copied once into a Float64Array over a
+ * SharedArrayBuffer that workers read and write in place. Then times a
+ * `@parallel` map over the same floats, run on the pool and sequentially.
+ *
+ * Usage:
+ *   npm run build && node bench/transfer.js
+ */
+
+import { availableParallelism } from 'node:os';
+import { deserialize, serialize } from 'node:v8';
+import { compile, formatCompilerErrors } from '../dist/index.js';
+
+const SAMPLES = 5;
+const LENGTH = 10_000_000;
+
+const floats = Array.from({ length: LENGTH }, (_, i) => i * 0.25);
+
+const source =
+  `let scale = (xs) => xs\n` +
+  `  |> @parallel(minSize: 100000, chunkSize: 100000) map((x) => x * 1.5 + 0.5, _)\n`;
+
+function build(parallelStages) {
+  const compiled = compile(source, { parallelStages });
+  if (!compiled.success) {
+    console.error(formatCompilerErrors(compiled.errors));
+    process.exit(1);
+  }
+  return new Function(`${compiled.code}\nreturn scale;`)();
+}
+
+/**
+ * Best time of one call to `fn`, in milliseconds
+ */
+function best(fn) {
+  fn();
+  let fastest = Infinity;
+  for (let i = 0; i < SAMPLES; i++) {
+    const start = performance.now();
+    fn();
+    fastest = Math.min(fastest, performance.now() - start);
+  }
+  return fastest;
+}
+
+const serialized = best(() => {
+  const sent = deserialize(serialize(floats));
+  deserialize(serialize(sent));
+});
+
+const shared = best(() => {
+  const numbers = new Float64Array(new SharedArrayBuffer(LENGTH * 8));
+  for (let i = 0; i < LENGTH; i++) numbers[i] = floats[i];
+  const results = [];
+  for (let i = 0; i < LENGTH; i++) results.push(numbers[i]);
+});
+
+const sequential = build(false);
+const parallel = build(true);
+if (JSON.stringify(sequential(floats.slice(0, 200_000))) !== JSON.stringify(parallel(floats.slice(0, 200_000)))) {
+  console.error('parallel result differs');
+  process.exit(1);
+}
+
+console.log(`${availableParallelism()} cores, ${LENGTH} floats`);
+console.log('moving the list there and back (ms)');
+console.log(`  serialized        ${serialized.toFixed(2)}`);
+console.log(`  shared            ${shared.toFixed(2)}`);
+console.log('map((x) => x * 1.5 + 0.5, _) (ms)');
+console.log(`  sequential        ${best(() => sequential(floats)).toFixed(2)}`);
+console.log(`  parallel          ${best(() => parallel(floats)).toFixed(2)}`);
@@ -4,10 +4,17 @@
  * Simple CLI Compiler for Lambdawg
  * 
  * Usage:
- *   node examples/cli-compiler.js input.lw [-o output.js] [--run]
+ *   node examples/cli-compiler.js input.lw [-o output.js] [--run] [--cache dir]
  */
 
-import { compile, formatCompilerErrors } from '../dist/index.js';
+import {
+  compile,
+  formatCompilerErrors,
+  formatProfile,
+  toChromeTrace,
+  CompileCache,
+} from '../dist/index.js';
+import { FileCacheStorage } from '../dist/cache/fs.js';
 import { readFileSync, writeFileSync } from 'fs';
 import { resolve } from 'path';
 
@@ -25,6 +32,8 @@ Options:
   -r, --run              Run the compiled JavaScript
   -c, --check            Check without generating code
   --no-typecheck         Skip type checking
+  --cache <dir>          Reuse unchanged declarations from a cache directory
+  --profile <file>       Print phase timings and write a Chrome trace to file
   -h, --help             Show this help
 
 Examples:
@@ -45,6 +54,8 @@ let outputFile = null;
 let shouldRun = false;
 let checkOnly = false;
 let skipTypeCheck = false;
+let cacheDir = null;
+let profileFile = null;
 
 // Parse arguments
 for (let i = 1; i < args.length; i++) {
@@ -58,6 +69,10 @@ for (let i = 1; i < args.length; i++) {
     checkOnly = true;
   } else if (arg === '--no-typecheck') {
     skipTypeCheck = true;
+  } else if (arg === '--cache') {
+    cacheDir = args[++i];
+  } else if (arg === '--profile') {
+    profileFile = args[++i];
   }
 }
 
@@ -72,7 +87,19 @@ try {
   const result = compile(source, {
     filename: inputFile,
     skipTypeCheck,
+    cache: cacheDir ? new CompileCache(new FileCacheStorage(resolve(cacheDir))) : undefined,
+    profile: profileFile !== null,
   });
+
+  if (result.profile) {
+    console.error(formatProfile(result.profile));
+    writeFileSync(resolve(profileFile), toChromeTrace(result.profile), 'utf-8');
+    console.error(`Trace written to ${profileFile}`);
+  }
+
+  if (result.cache) {
+    console.error(`Cache: ${result.cache.hits} hits, ${result.cache.misses} misses`);
+  }
   
   // Handle errors
   if (!result.success) {
@@ -1,5 +1,5 @@
 import * as monaco from 'monaco-editor';
-import { compile, formatCompilerErrors } from '../../dist/index.js';
+import { compile, checkProgram, formatCompilerErrors, IncrementalParser } from '../../dist/index.js';
 import { registerLambdawgLanguage } from './language.js';
 import './styles.css';
 
@@ -95,17 +95,32 @@ function initPlayground() {
   // Setup event listeners
   setupEventListeners(editor);
   
-  // Auto-compile on change (debounced)
+  // Keep the parse tree up to date incrementally, so only the edited
+  // top-level statements are relexed and reparsed on each keystroke
+  const parser = new IncrementalParser(editor.getValue());
+
+  // Auto-check on change (debounced)
   let compileTimeout;
-  editor.onDidChangeModelContent(() => {
+  editor.onDidChangeModelContent((e) => {
+    if (e.changes.length === 1) {
+      const change = e.changes[0];
+      parser.edit({
+        start: change.rangeOffset,
+        end: change.rangeOffset + change.rangeLength,
+        text: change.text,
+      });
+    } else {
+      parser.reset(editor.getValue());
+    }
+
     clearTimeout(compileTimeout);
     compileTimeout = setTimeout(() => {
-      checkCode(editor);
+      checkCode(editor, parser);
     }, 500);
   });
 
   // Initial check
-  checkCode(editor);
+  checkCode(editor, parser);
 }
 
 function setupEventListeners(editor) {
@@ -135,12 +150,11 @@ function setupEventListeners(editor) {
   });
 }
 
-function checkCode(editor) {
-  const code = editor.getValue();
+function checkCode(editor, parser) {
   const status = document.getElementById('status');
   
   try {
-    const result = compile(code, { filename: 'playground.lw' });
+    const result = checkProgram(parser.source, parser.result, { filename: 'playground.lw' });
     
     if (result.success) {
       status.textContent = '✓ Ready';
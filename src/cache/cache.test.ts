@@ -0,0 +1,86 @@
+import { describe, it, expect } from 'vitest';
+import { mkdtempSync, readdirSync, rmSync } from 'node:fs';
+import { tmpdir } from 'node:os';
+import { join } from 'node:path';
+import { compile } from '../compiler.js';
+import { CompileCache } from './cache.js';
+import { FileCacheStorage } from './fs.js';
+
+const SOURCE = `
+let base = 10
+let scale = (x) => x * base
+let label = "total"
+let report = (x) => label
+module math {
+  let twice = (x) => scale(x) * 2
+}
+`;
+
+describe('CompileCache', () => {
+  it('reuses every declaration when nothing changed', () => {
+    const cache = new CompileCache();
+    const first = compile(SOURCE, { cache });
+    const second = compile(SOURCE, { cache });
+
+    expect(first.cache).toEqual({ hits: 0, misses: 5 });
+    expect(second.cache).toEqual({ hits: 5, misses: 0 });
+    expect(second.code).toBe(first.code);
+  });
+
+  it('ignores changes that only move code around', () => {
+    const cache = new CompileCache();
+    compile(SOURCE, { cache });
+    const result = compile('\n\n' + SOURCE.replace('let base = 10', 'let base   =   10'), { cache });
+
+    expect(result.cache).toEqual({ hits: 5, misses: 0 });
+  });
+
+  it('re-checks a changed binding and its dependents only', () => {
+    const cache = new CompileCache();
+    compile(SOURCE, { cache });
+    const source = SOURCE.replace('let base = 10', 'let base = 20');
+    const result = compile(source, { cache });
+
+    // base, scale and math miss; label and report are reused
+    expect(result.cache).toEqual({ hits: 2, misses: 3 });
+    expect(result.code).toBe(compile(source).code);
+  });
+
+  it('re-checks functions calling a changed function declared after them', () => {
+    const cache = new CompileCache();
+    const source = `
+let isEven = (n) => if n == 0 then true else isOdd(n - 1)
+let isOdd = (n) => if n == 0 then false else isEven(n - 1)
+let label = "parity"
+`;
+    compile(source, { cache });
+    const changed = source.replace('then false', 'then true');
+    const result = compile(changed, { cache });
+
+    // isEven and isOdd miss together; label is reused
+    expect(result.cache).toEqual({ hits: 1, misses: 2 });
+    expect(result.code).toBe(compile(changed).code);
+  });
+
+  it('reports type errors introduced through a dependency', () => {
+    const cache = new CompileCache();
+    compile(SOURCE, { cache });
+    const result = compile(SOURCE.replace('let base = 10', 'let base = "ten"'), { cache });
+
+    expect(result.success).toBe(false);
+    expect(result.errors[0]?.code).toBe('T001');
+  });
+
+  it('persists entries on disk', () => {
+    const dir = mkdtempSync(join(tmpdir(), 'lambdawg-cache-'));
+    try {
+      compile(SOURCE, { cache: new CompileCache(new FileCacheStorage(dir)) });
+      const result = compile(SOURCE, { cache: new CompileCache(new FileCacheStorage(dir)) });
+
+      expect(readdirSync(dir)).toHaveLength(5);
+      expect(result.cache).toEqual({ hits: 5, misses: 0 });
+    } finally {
+      rmSync(dir, { recursive: true, force: true });
+    }
+  });
+});
@@ -0,0 +1,227 @@
+/**
+ * Compilation cache for top-level declarations
+ *
+ * Every top-level module and statement gets a key derived from its AST
+ * (ignoring source positions) and from the keys of the top-level bindings
+ * it refers to; declarations referring to each other, such as mutually
+ * recursive functions, are keyed together. A cached entry holds the
+ * declaration's inferred type scheme and its generated JavaScript, so an
+ * unchanged declaration whose dependencies are unchanged is neither
+ * re-checked nor re-emitted. Editing a binding changes its key and,
+ * transitively, the keys of everything that depends on it.
+ */
+
+import * as ast from '../parser/ast.js';
+import { TypeCheckResult, SerializedScheme, serializeScheme } from '../types/index.js';
+import { EmitResult } from '../codegen/index.js';
+import { stronglyConnected } from '../optimize/index.js';
+
+/**
+ * Bump whenever the checker or emitter output for a given AST changes, so
+ * that entries written by older compilers are not reused.
+ */
+const CACHE_VERSION = 23;
+
+// ============================================================================
+// Storage
+// ============================================================================
+
+/**
+ * Key-value store backing a CompileCache
+ */
+export interface CacheStorage {
+  get(key: string): string | undefined;
+  set(key: string, value: string): void;
+}
+
+export class MemoryCacheStorage implements CacheStorage {
+  private entries: Map<string, string> = new Map();
+
+  get(key: string): string | undefined {
+    return this.entries.get(key);
+  }
+
+  set(key: string, value: string): void {
+    this.entries.set(key, value);
+  }
+}
+
+// ============================================================================
+// Compile Cache
+// ============================================================================
+
+export type Declaration = ast.Module | ast.Statement;
+
+export interface CacheStats {
+  /** Declarations restored from the cache */
+  hits: number;
+  /** Declarations that had to be checked and emitted */
+  misses: number;
+}
+
+export interface CacheLookup {
+  /** Key of every top-level declaration */
+  keys: Map<Declaration, string>;
+  /** Declarations found in the cache, with their schemes (null for non-let declarations) */
+  checked: Map<Declaration, SerializedScheme | null>;
+  /** Generated code of declarations found in the cache */
+  fragments: Map<Declaration, string>;
+  stats: CacheStats;
+}
+
+interface CacheEntry {
+  scheme: SerializedScheme | null;
+  code: string;
+}
+
+export class CompileCache {
+  private storage: CacheStorage;
+
+  constructor(storage: CacheStorage = new MemoryCacheStorage()) {
+    this.storage = storage;
+  }
+
+  /**
+   * Compute keys for the program's top-level declarations and fetch the
+   * ones already cached. `salt` should identify every option that affects
+   * the generated code.
+   */
+  lookup(program: ast.Program, salt: string): CacheLookup {
+    const lookup: CacheLookup = {
+      keys: new Map(),
+      checked: new Map(),
+      fragments: new Map(),
+      stats: { hits: 0, misses: 0 },
+    };
+    const prefix = `${CACHE_VERSION}\0${salt}\0`;
+    const decls: Declaration[] = [...program.statements, ...program.modules];
+    const shapes = decls.map(declarationShape);
+
+    // The declaration each top-level name refers to: the latest let of it
+    // before the reference or, from a statement, the first function let
+    // of it after (which a lambda may call). Statements are checked in
+    // order before any module, so modules see the final bindings.
+    const first = new Map<string, number>();
+    const last = new Map<string, number>();
+    decls.forEach((decl, i) => {
+      if (decl.kind !== 'LetStatement') return;
+      if (decl.value.kind === 'FunctionExpression' && !first.has(decl.name.name)) first.set(decl.name.name, i);
+      last.set(decl.name.name, i);
+    });
+    const bindings = new Map<string, number>();
+    const deps = decls.map((decl, i) => {
+      const resolved = new Map<string, number>();
+      for (const name of shapes[i]!.names) {
+        const target = bindings.get(name) ?? (i < program.statements.length ? first.get(name) : last.get(name));
+        if (target !== undefined && target !== i) resolved.set(name, target);
+      }
+      if (decl.kind === 'LetStatement') bindings.set(decl.name.name, i);
+      return resolved;
+    });
+
+    // Declarations referring to each other share a key, computed once the
+    // keys of everything they refer to are known, so that editing one
+    // changes the keys of the rest
+    const keys: string[] = [];
+    for (const component of stronglyConnected(deps.map(resolved => [...resolved.values()]))) {
+      const members = new Set(component);
+      const outside: string[] = [];
+      for (const i of component) {
+        for (const [name, target] of deps[i]!) {
+          if (!members.has(target)) outside.push(`${name}=${keys[target]}`);
+        }
+      }
+      const text = prefix + component.map(i => shapes[i]!.shape).join('\0') + '\0' + [...new Set(outside)].sort().join(',');
+      component.forEach((i, position) => {
+        keys[i] = hashString(component.length === 1 ? text : `${text}\0${position}`);
+      });
+    }
+
+    decls.forEach((decl, i) => {
+      const key = keys[i]!;
+      lookup.keys.set(decl, key);
+
+      const entry = this.read(key);
+      if (entry && (entry.scheme !== null) === (decl.kind === 'LetStatement')) {
+        lookup.checked.set(decl, entry.scheme);
+        lookup.fragments.set(decl, entry.code);
+        lookup.stats.hits++;
+      } else {
+        lookup.stats.misses++;
+      }
+    });
+    return lookup;
+  }
+
+  /**
+   * Store the declarations missed by `lookup` once the program has been
+   * checked and emitted without errors
+   */
+  store(lookup: CacheLookup, types: TypeCheckResult, emitted: EmitResult): void {
+    for (const [decl, key] of lookup.keys) {
+      if (lookup.fragments.has(decl)) continue;
+
+      const code = emitted.fragments.get(decl);
+      if (code === undefined) continue;
+
+      let scheme: SerializedScheme | null = null;
+      if (decl.kind === 'LetStatement') {
+        const inferred = types.schemes.get(decl);
+        scheme = inferred ? serializeScheme(inferred) : null;
+        if (!scheme) continue;
+      }
+
+      const entry: CacheEntry = { scheme, code };
+      this.storage.set(key, JSON.stringify(entry));
+    }
+  }
+
+  private read(key: string): CacheEntry | null {
+    const data = this.storage.get(key);
+    if (data === undefined) return null;
+    try {
+      return JSON.parse(data) as CacheEntry;
+    } catch {
+      // Treat corrupt entries as missing; they are overwritten on store
+      return null;
+    }
+  }
+}
+
+// ============================================================================
+// Hashing
+// ============================================================================
+
+/**
+ * A declaration's AST without source positions, and the names it
+ * mentions. Locals that shadow a top-level name still count as
+ * references, which can only cause extra misses.
+ */
+function declarationShape(decl: Declaration): { shape: string; names: Set<string> } {
+  const names = new Set<string>();
+  const shape = JSON.stringify(decl, (key, value) => {
+    if (key === 'span') return undefined;
+    if (value?.kind === 'Identifier') names.add(value.name);
+    return value;
+  });
+  return { shape, names };
+}
+
+/**
+ * 64-bit string hash, returned as 16 hex digits
+ */
+export function hashString(text: string): string {
+  let h1 = 0xdeadbeef;
+  let h2 = 0x41c6ce57;
+  for (let i = 0; i < text.length; i++) {
+    const ch = text.charCodeAt(i);
+    h1 = Math.imul(h1 ^ ch, 2654435761);
+    h2 = Math.imul(h2 ^ ch, 1597334677);
+  }
+  h1 = Math.imul(h1 ^ (h1 >>> 16), 2246822507);
+  h1 ^= Math.imul(h2 ^ (h2 >>> 13), 3266489909);
+  h2 = Math.imul(h2 ^ (h2 >>> 16), 2246822507);
+  h2 ^= Math.imul(h1 ^ (h1 >>> 13), 3266489909);
+
+  return (h2 >>> 0).toString(16).padStart(8, '0') + (h1 >>> 0).toString(16).padStart(8, '0');
+}
@@ -0,0 +1,43 @@
+/**
+ * On-disk storage for the compilation cache (Node.js only)
+ *
+ * Kept out of the main entry point so that browser bundles of the
+ * compiler do not pull in `node:fs`. Import it from
+ * `@lambdawg/compiler/cache/fs`.
+ */
+
+import { mkdirSync, readFileSync, renameSync, writeFileSync } from 'node:fs';
+import { join } from 'node:path';
+import { CacheStorage } from './cache.js';
+
+/**
+ * Stores each cache entry as `<dir>/<key>.json`
+ */
+export class FileCacheStorage implements CacheStorage {
+  private dir: string;
+
+  constructor(dir: string) {
+    this.dir = dir;
+    mkdirSync(dir, { recursive: true });
+  }
+
+  get(key: string): string | undefined {
+    try {
+      return readFileSync(this.pathFor(key), 'utf-8');
+    } catch {
+      return undefined;
+    }
+  }
+
+  set(key: string, value: string): void {
+    // Write then rename, so concurrent compilers never read a partial entry
+    const path = this.pathFor(key);
+    const temp = `${path}.${process.pid}.tmp`;
+    writeFileSync(temp, value, 'utf-8');
+    renameSync(temp, path);
+  }
+
+  private pathFor(key: string): string {
+    return join(this.dir, `${key}.json`);
+  }
+}
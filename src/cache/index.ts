@@ -0,0 +1,2 @@
+export { CompileCache, MemoryCacheStorage, hashString } from './cache.js';
+export type { CacheStorage, CacheStats, CacheLookup, Declaration } from './cache.js';
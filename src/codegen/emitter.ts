@@ -3,50 +3,184 @@
  */
 
 import * as ast from '../parser/ast.js';
+import type {
+  FusionPlan,
+  FusedLoop,
+  ParallelPlan,
+  ParallelStage,
+  SyncDoPlan,
+  TailCall,
+  TailCallPlan,
+  TailGroup,
+  TailLoop,
+} from '../optimize/index.js';
+import { parallelRuntime } from './parallel.js';
 
 export interface EmitResult {
   code: string;
   sourceMap?: string;
+  /** Code generated for each top-level module and statement */
+  fragments: Map<ast.Module | ast.Statement, string>;
 }
 
 export interface EmitOptions {
   minify?: boolean;
   sourceMap?: boolean;
   runtime?: 'browser' | 'node';
+  /**
+   * Emit blocks, matches and provide expressions whose value is returned
+   * from a function or bound by a let as statements, instead of as an
+   * immediately invoked function (default: true)
+   */
+  lowerToStatements?: boolean;
+}
+
+/**
+ * Where statements emitted for an expression deliver its value: returned
+ * from the enclosing function, or assigned to a variable before leaving
+ * the labelled block that computes it. A function emitted as a loop
+ * returns the values of its tail calls to itself by starting over.
+ */
+type Tail =
+  | { kind: 'return'; loop?: TailLoop }
+  | { kind: 'assign'; name: string; label: string };
+
+const RETURN: Tail = { kind: 'return' };
+
+/**
+ * Accessors leading from a match subject to one of its parts, e.g.
+ * ['.value', '.at(0)'] for the first element of a Some payload
+ */
+type SubjectPath = string[];
+
+/** What a pattern requires of the subject and what it binds from it */
+interface PatternPlan {
+  /** Comparisons such as `.__tag === "Some"` applied to the value at a path */
+  tests: { path: SubjectPath; comparison: string }[];
+  /** Variables, read from a path; a list's rest drops its first `rest` elements */
+  bindings: { name: string; path: SubjectPath; rest?: number }[];
+}
+
+/**
+ * Whether evaluating an expression can neither fail nor have an effect,
+ * so that it may be moved past other evaluations
+ */
+function isSideEffectFree(expr: ast.Expression): boolean {
+  switch (expr.kind) {
+    case 'Identifier':
+    case 'Literal':
+    case 'FunctionExpression':
+    case 'PlaceholderExpression':
+      return true;
+    case 'ListExpression':
+      return expr.elements.every(isSideEffectFree);
+    case 'RecordExpression':
+      return (!expr.spread || isSideEffectFree(expr.spread)) &&
+        expr.fields.every(field => isSideEffectFree(field.value));
+    default:
+      return false;
+  }
+}
+
+/**
+ * Names the statements lowered from `expr` declare in the block they are
+ * emitted into. Match arms bind theirs in blocks of their own.
+ */
+function loweredNames(expr: ast.Expression): string[] {
+  if (expr.kind === 'BlockExpression') {
+    if (expr.statements.length === 0 && expr.result) return loweredNames(expr.result);
+    const names: string[] = [];
+    for (const stmt of expr.statements) ast.statementNames(stmt, names);
+    return names;
+  }
+  if (expr.kind === 'ProvideExpression') {
+    return expr.provisions.map(p => p.name.name);
+  }
+  return [];
 }
 
 export class Emitter {
   private output: string[] = [];
   private indent = 0;
   private options: EmitOptions;
+  /** Temporaries needed so far by the innermost match being emitted */
+  private matchTemps = 0;
+  /** Labelled blocks enclosing the code being emitted */
+  private labels = 0;
+  /** Fused loops enclosing the code being emitted */
+  private loops = 0;
+  /** Combinator chains to emit as single loops */
+  private fusion: FusionPlan = new Map();
+  /** Pipeline stages to run on worker threads */
+  private parallel: ParallelPlan = new Map();
+  /** Functions to emit as loops */
+  private tailCalls: TailCallPlan = new Map();
+  /** Temporaries holding tail call arguments so far */
+  private tailTemps = 0;
+  /** Do blocks to emit without promises */
+  private syncDo: SyncDoPlan = new Set();
 
   constructor(options: EmitOptions = {}) {
     this.options = {
       minify: false,
       sourceMap: false,
       runtime: 'browser',
+      lowerToStatements: true,
       ...options,
     };
   }
 
-  emit(program: ast.Program): EmitResult {
+  /**
+   * Emit a program. Top-level declarations found in `reuse` are written
+   * verbatim from there instead of being generated again, the chains in
+   * `fusion` are emitted as single loops, the stages in `parallel` are
+   * handed to the worker pool, the functions in `tailCalls` loop
+   * instead of calling themselves and the do blocks in `syncDo` run as
+   * plain functions.
+   */
+  emit(
+    program: ast.Program,
+    reuse: Map<ast.Module | ast.Statement, string> = new Map(),
+    fusion: FusionPlan = new Map(),
+    parallel: ParallelPlan = new Map(),
+    tailCalls: TailCallPlan = new Map(),
+    syncDo: SyncDoPlan = new Set()
+  ): EmitResult {
     this.output = [];
+    this.fusion = fusion;
+    this.parallel = parallel;
+    this.tailCalls = tailCalls;
+    this.syncDo = syncDo;
+    const fragments = new Map<ast.Module | ast.Statement, string>();
+
+    const emitFragment = <T extends ast.Module | ast.Statement>(node: T, emitNode: (node: T) => void) => {
+      let code = reuse.get(node);
+      if (code === undefined) {
+        const start = this.output.length;
+        emitNode(node);
+        code = this.output.splice(start).join('');
+      }
+      this.output.push(code);
+      fragments.set(node, code);
+    };
     
     // Emit runtime helpers
     this.emitRuntimeHelpers();
+    if (parallel.size > 0) this.emitParallelRuntime();
     
     // Emit modules
     for (const module of program.modules) {
-      this.emitModule(module);
+      emitFragment(module, m => this.emitModule(m));
     }
     
     // Emit top-level statements
     for (const stmt of program.statements) {
-      this.emitStatement(stmt);
+      emitFragment(stmt, s => this.emitStatement(s));
     }
 
     return {
       code: this.output.join(''),
+      fragments,
     };
   }
 
@@ -89,8 +223,9 @@ export class Emitter {
     this.writeLine('fold: (fn, init, list) => list.reduce((acc, x) => fn(acc, x), init),');
     this.writeLine('sum: (list) => list.reduce((a, b) => a + b, 0),');
     this.writeLine('length: (list) => list.length,');
-    this.writeLine('head: (list) => list.length > 0 ? __lw.Some(list[0]) : __lw.None,');
-    this.writeLine('tail: (list) => list.length > 0 ? __lw.Some(list.slice(1)) : __lw.None,');
+    this.writeLine('head: (list) => list.length > 0 ? __lw.Some(list.at(0)) : __lw.None,');
+    this.writeLine('tail: (list) => list.length > 0 ? __lw.Some(__lw.drop(list, 1)) : __lw.None,');
+    this.emitListView();
     
     // Utility functions
     this.writeLine('show: (x) => JSON.stringify(x),');
@@ -102,6 +237,7 @@ export class Emitter {
     
     this.indent--;
     this.writeLine('};');
+    this.emitListViewIndexing();
     this.writeLine('');
     
     // Expose built-ins
@@ -110,6 +246,111 @@ export class Emitter {
     this.writeLine('');
   }
 
+  /**
+   * Emit `__lw.ListView`, a list made of the elements of another from
+   * `start` to `end`, and `__lw.drop`, which makes one without copying.
+   * Lists are never mutated, so a view shares its backing array with the
+   * list it came from and with every view taken from it, and taking the
+   * tail of a list is O(1). Views read like arrays through `length`,
+   * indexing, `at`, iteration and the methods the runtime calls on lists,
+   * but are not arrays: `Array.isArray` is false for them, and JavaScript
+   * code needing an array, given a tail or a rest binding, can copy one
+   * with `Array.from`.
+   */
+  private emitListView(): void {
+    this.writeLine('ListView: class {');
+    this.indent++;
+    // Declared, so that construction defines them without looking along
+    // the prototype chain for setters
+    this.writeLine('items;');
+    this.writeLine('start;');
+    this.writeLine('length;');
+    this.writeLine('constructor(items, start, end) {');
+    this.indent++;
+    this.writeLine('this.items = items;');
+    this.writeLine('this.start = start;');
+    this.writeLine('this.length = end - start;');
+    this.indent--;
+    this.writeLine('}');
+    this.writeLine('at(i) {');
+    this.indent++;
+    this.writeLine('const index = i < 0 ? i + this.length : i;');
+    this.writeLine('return index >= 0 && index < this.length ? this.items[this.start + index] : undefined;');
+    this.indent--;
+    this.writeLine('}');
+    this.writeLine('slice(from = 0, to = this.length) {');
+    this.indent++;
+    this.writeLine('const clamp = (i) => Math.min(this.length, Math.max(0, i < 0 ? i + this.length : i));');
+    this.writeLine('const start = this.start + clamp(from);');
+    this.writeLine('return new __lw.ListView(this.items, start, Math.max(start, this.start + clamp(to)));');
+    this.indent--;
+    this.writeLine('}');
+    this.writeLine('map(fn) {');
+    this.indent++;
+    this.writeLine('const result = new Array(this.length);');
+    this.writeLine('for (let i = 0; i < this.length; i++) result[i] = fn(this.items[this.start + i]);');
+    this.writeLine('return result;');
+    this.indent--;
+    this.writeLine('}');
+    this.writeLine('filter(fn) {');
+    this.indent++;
+    this.writeLine('const result = [];');
+    this.writeLine('for (const x of this) if (fn(x)) result.push(x);');
+    this.writeLine('return result;');
+    this.indent--;
+    this.writeLine('}');
+    this.writeLine('reduce(fn, init) {');
+    this.indent++;
+    this.writeLine('let acc = init;');
+    this.writeLine('for (let i = 0; i < this.length; i++) acc = fn(acc, this.items[this.start + i]);');
+    this.writeLine('return acc;');
+    this.indent--;
+    this.writeLine('}');
+    this.writeLine('*[Symbol.iterator]() {');
+    this.indent++;
+    this.writeLine('for (let i = 0; i < this.length; i++) yield this.items[this.start + i];');
+    this.indent--;
+    this.writeLine('}');
+    this.writeLine('toJSON() {');
+    this.indent++;
+    this.writeLine('return this.items.slice(this.start, this.start + this.length);');
+    this.indent--;
+    this.writeLine('}');
+    this.indent--;
+    this.writeLine('},');
+    this.writeLine('drop: (list, n) => list instanceof __lw.ListView ? list.slice(n) : new __lw.ListView(list, Math.min(n, list.length), list.length),');
+    this.writeLine('at: (value, i) => value instanceof __lw.ListView ? (i >= 0 ? value.at(i) : undefined) : value[i],');
+  }
+
+  /**
+   * Let JavaScript code index views as it would arrays. The prototype
+   * chain of a view ends in a proxy, which is only reached for names the
+   * view and its class lack, so the runtime's own reads never go through
+   * it.
+   */
+  private emitListViewIndexing(): void {
+    this.writeLine('Object.setPrototypeOf(__lw.ListView.prototype, new Proxy(Object.prototype, {');
+    this.indent++;
+    this.writeLine('get(target, key, view) {');
+    this.indent++;
+    this.writeLine('const i = typeof key === "string" ? Number(key) : -1;');
+    this.writeLine('if (Number.isInteger(i) && i >= 0 && String(i) === key) return i < view.length ? view.items[view.start + i] : undefined;');
+    this.writeLine('return Reflect.get(target, key, view);');
+    this.indent--;
+    this.writeLine('},');
+    this.indent--;
+    this.writeLine('}));');
+  }
+
+  /**
+   * Emit `__lw.parallel`, the work-stealing scheduler parallel stages run
+   * on, given the runtime helpers emitted so far for its workers
+   */
+  private emitParallelRuntime(): void {
+    this.output.push(parallelRuntime(this.output.join('')));
+    this.writeLine('');
+  }
+
   private emitModule(module: ast.Module): void {
     this.writeLine(`// Module: ${module.name.name}`);
     this.writeLine(`const ${module.name.name} = (() => {`);
@@ -153,6 +394,32 @@ export class Emitter {
   }
 
   private emitLetStatement(stmt: ast.LetStatement): void {
+    const loop = this.tailCalls.get(stmt);
+    if (loop && this.options.lowerToStatements) {
+      const group = loop.group;
+      if (!group) {
+        this.emitTailLoop(stmt.name.name, loop);
+        return;
+      }
+      if (group.members[0] === loop) this.emitTailGroup(group);
+      const args = [group.members.indexOf(loop), ...loop.params];
+      this.writeLine(`const ${stmt.name.name} = (${loop.params.join(', ')}) => ${group.name}(${args.join(', ')});`);
+      return;
+    }
+
+    const hasAmbients = stmt.ambients !== undefined && stmt.ambients.ambients.length > 0;
+    if (!hasAmbients && this.lowersToStatements(stmt.value)) {
+      const label = `__b${this.labels++}`;
+      this.writeLine(`let ${stmt.name.name};`);
+      this.writeLine(`${label}: {`);
+      this.indent++;
+      this.emitTail(stmt.value, { kind: 'assign', name: stmt.name.name, label }, true);
+      this.indent--;
+      this.writeLine('}');
+      this.labels--;
+      return;
+    }
+
     this.write(this.getIndent());
     this.write(`const ${stmt.name.name} = `);
     
@@ -222,7 +489,11 @@ export class Emitter {
         this.emitFunctionExpression(expr);
         break;
       case 'CallExpression':
-        this.emitCallExpression(expr);
+        if (this.fusion.has(expr)) {
+          this.emitFusedExpression(this.fusion.get(expr)!);
+        } else {
+          this.emitCallExpression(expr);
+        }
         break;
       case 'MemberExpression':
         this.emitMemberExpression(expr);
@@ -237,7 +508,13 @@ export class Emitter {
         this.emitBinaryExpression(expr);
         break;
       case 'PipelineExpression':
-        this.emitPipelineExpression(expr);
+        if (this.fusion.has(expr)) {
+          this.emitFusedExpression(this.fusion.get(expr)!);
+        } else if (this.parallel.has(expr)) {
+          this.emitParallelStage(this.parallel.get(expr)!);
+        } else {
+          this.emitPipelineExpression(expr);
+        }
         break;
       case 'IfExpression':
         this.emitIfExpression(expr);
@@ -249,7 +526,7 @@ export class Emitter {
         this.emitDoExpression(expr);
         break;
       case 'DoEffectExpression':
-        this.write('await ');
+        if (!this.syncDo.has(expr)) this.write('await ');
         this.emitExpression(expr.expression);
         break;
       case 'BlockExpression':
@@ -324,7 +601,24 @@ export class Emitter {
       this.emitPattern(func.params[i]!);
     }
     this.write(') => ');
-    this.emitExpression(func.body);
+    if (this.lowersToStatements(func.body)) {
+      // Names redeclaring a parameter need a block nested in the body
+      const params = func.params.flatMap(param => ast.patternNames(param));
+      const shadows = loweredNames(func.body).some(name => params.includes(name));
+      this.write('{\n');
+      this.indent++;
+      this.emitTail(func.body, RETURN, !shadows);
+      this.indent--;
+      this.write(this.getIndent());
+      this.write('}');
+    } else if (func.body.kind === 'RecordExpression') {
+      // A bare `{` after the arrow would start a block body
+      this.write('(');
+      this.emitExpression(func.body);
+      this.write(')');
+    } else {
+      this.emitExpression(func.body);
+    }
   }
 
   private emitCallExpression(call: ast.CallExpression): void {
@@ -374,10 +668,12 @@ export class Emitter {
   }
 
   private emitIndexExpression(index: ast.IndexExpression): void {
+    // Lists may be views, which __lw.at indexes as it would an array
+    this.write('__lw.at(');
     this.emitExpression(index.object);
-    this.write('[');
+    this.write(', ');
     this.emitExpression(index.index);
-    this.write(']');
+    this.write(')');
   }
 
   private emitUnaryExpression(unary: ast.UnaryExpression): void {
@@ -401,8 +697,37 @@ export class Emitter {
   }
 
   private emitPipelineExpression(pipe: ast.PipelineExpression): void {
-    // Transform |> into function call
-    // left |> right becomes right(left) or __lw.pipe(left, right)
+    // `x |> f(a, _)` becomes `f(a, x)` and `x |> f` becomes `f(x)`, so a
+    // chain of stages folds into nested calls with no partial application
+    // closure and no call through the runtime. The piped value used to be
+    // evaluated first; it only moves after the callee and the other
+    // arguments where the order cannot be observed.
+    const right = pipe.right;
+    const placeholders = right.kind === 'CallExpression'
+      ? right.args.filter(arg => arg.kind === 'PlaceholderExpression').length
+      : 0;
+    const reorderable = isSideEffectFree(pipe.left);
+
+    if (right.kind === 'CallExpression' && placeholders === 1) {
+      if (reorderable || (isSideEffectFree(right.callee) && right.args.every(isSideEffectFree))) {
+        this.emitCallee(right.callee);
+        this.write('(');
+        for (let i = 0; i < right.args.length; i++) {
+          if (i > 0) this.write(', ');
+          const arg = right.args[i]!;
+          this.emitExpression(arg.kind === 'PlaceholderExpression' ? pipe.left : arg);
+        }
+        this.write(')');
+        return;
+      }
+    } else if (placeholders === 0 && (reorderable || isSideEffectFree(right))) {
+      this.emitCallee(right);
+      this.write('(');
+      this.emitExpression(pipe.left);
+      this.write(')');
+      return;
+    }
+
     this.write('__lw.pipe(');
     this.emitExpression(pipe.left);
     this.write(', ');
@@ -410,6 +735,50 @@ export class Emitter {
     this.write(')');
   }
 
+  /**
+   * Emit a stage such as `xs |> @parallel(minSize: 1000) map(f, _)` as a
+   * call to the worker pool, passing the variables the function captures
+   * by name and the hint options the runtime knows
+   */
+  private emitParallelStage(stage: ParallelStage): void {
+    this.write(`__lw.parallel("${stage.kind}", `);
+    this.emitExpression(stage.fn);
+    this.write(', ');
+    this.emitExpression(stage.list);
+    const captures = stage.captures.map(name => this.sanitizeIdentifier(name));
+    this.write(captures.length > 0 ? `, { ${captures.join(', ')} }, {` : ', {}, {');
+    const options = ast.PARALLEL_HINT_OPTIONS.filter(key => stage.hint.options[key] !== undefined);
+    options.forEach((key, i) => {
+      this.write(i > 0 ? `, ${key}: ` : ` ${key}: `);
+      this.emitExpression(stage.hint.options[key]!);
+    });
+    this.write(options.length > 0 ? ' }' : '}');
+    const numeric = (['list', 'results'] as const).filter(key => stage.numeric[key]);
+    if (numeric.length > 0) {
+      this.write(`, { ${numeric.map(key => `${key}: true`).join(', ')} }`);
+    }
+    this.write(')');
+  }
+
+  /**
+   * Emit an expression in callee position, parenthesised unless a call
+   * can follow it directly
+   */
+  private emitCallee(callee: ast.Expression): void {
+    const direct = callee.kind === 'Identifier' ||
+      callee.kind === 'MemberExpression' ||
+      callee.kind === 'IndexExpression' ||
+      (callee.kind === 'CallExpression' &&
+        !callee.args.some(arg => arg.kind === 'PlaceholderExpression'));
+    if (direct) {
+      this.emitExpression(callee);
+    } else {
+      this.write('(');
+      this.emitExpression(callee);
+      this.write(')');
+    }
+  }
+
   private emitIfExpression(ifExpr: ast.IfExpression): void {
     this.write('(');
     this.emitExpression(ifExpr.condition);
@@ -420,122 +789,297 @@ export class Emitter {
     this.write(')');
   }
 
+  /**
+   * Matches compile to a backtracking automaton: each maximal run of arms
+   * whose patterns dispatch on the same property of the subject
+   * (constructor tag, literal value or exact list length) becomes one
+   * `switch` on that property, so it is read and compared once however
+   * many arms there are. Within a case the arms keep their source order,
+   * and a case whose arms all fail leaves the switch for the arms after
+   * the run. Other arms are tested in sequence between runs.
+   */
   private emitMatchExpression(match: ast.MatchExpression): void {
-    // Generate pattern matching code
     this.write('(() => {\n');
     this.indent++;
-    
+    this.emitMatchStatements(match, RETURN);
+    this.indent--;
+    this.write(this.getIndent());
+    this.write('})()');
+  }
+
+  private emitMatchStatements(match: ast.MatchExpression, tail: Tail): void {
     this.write(this.getIndent());
     this.write('const __subject = ');
     this.emitExpression(match.subject);
     this.write(';\n');
+
+    // Temporaries are declared once all arms are emitted and their number
+    // is known; nested matches have their own
+    const outerTemps = this.matchTemps;
+    this.matchTemps = 0;
+    const tempsDeclaration = this.output.length;
+    this.output.push('');
     
-    for (const arm of match.arms) {
-      this.write(this.getIndent());
-      this.write('if (');
-      this.emitPatternCondition(arm.pattern, '__subject');
-      
-      if (arm.guard) {
-        this.write(' && (');
-        this.emitExpression(arm.guard);
-        this.write(')');
+    let exhaustive = false;
+    let i = 0;
+    while (i < match.arms.length && !exhaustive) {
+      const arm = match.arms[i]!;
+      const test = this.matchDispatch(arm.pattern);
+
+      if (test === null) {
+        exhaustive = this.emitMatchArm(arm, false, tail);
+        i++;
+      } else {
+        let end = i + 1;
+        while (end < match.arms.length) {
+          const next = this.matchDispatch(match.arms[end]!.pattern);
+          if (next === null || next.property !== test.property) break;
+          end++;
+        }
+        this.emitMatchSwitch(match.arms.slice(i, end), test.property, tail);
+        i = end;
       }
-      
-      this.write(') {\n');
-      this.indent++;
-      
-      this.emitPatternBindings(arm.pattern, '__subject');
-      
-      this.write(this.getIndent());
-      this.write('return ');
-      this.emitExpression(arm.body);
-      this.write(';\n');
-      
-      this.indent--;
-      this.write(this.getIndent());
-      this.write('}\n');
     }
     
-    this.write(this.getIndent());
-    this.write('throw new Error("Non-exhaustive pattern match");\n');
-    
-    this.indent--;
-    this.write(this.getIndent());
-    this.write('})()');
+    if (!exhaustive) {
+      this.writeLine('throw new Error("Non-exhaustive pattern match");');
+    }
+
+    if (this.matchTemps > 0) {
+      const temps = Array.from({ length: this.matchTemps }, (_, i) => `__t${i}`);
+      this.output[tempsDeclaration] = `${this.getIndent()}let ${temps.join(', ')};\n`;
+    }
+    this.matchTemps = outerTemps;
   }
 
-  private emitPatternCondition(pattern: ast.Pattern, subject: string): void {
+  /**
+   * The property of the subject a pattern dispatches on and the value it
+   * requires, or null if the pattern is tested on its own
+   */
+  private matchDispatch(pattern: ast.Pattern): { property: string; value: string } | null {
     switch (pattern.kind) {
-      case 'IdentifierPattern':
-      case 'WildcardPattern':
-        this.write('true');
-        break;
-      
+      case 'ConstructorPattern':
+        return { property: '.__tag', value: JSON.stringify(pattern.name.name) };
       case 'LiteralPattern':
-        this.write(`(${subject} === ${JSON.stringify(pattern.value)})`);
-        break;
-      
+        return { property: '', value: JSON.stringify(pattern.value) };
       case 'ListPattern':
-        if (pattern.elements.length === 0 && !pattern.rest) {
-          this.write(`(${subject}.length === 0)`);
-        } else if (pattern.rest) {
-          this.write(`(${subject}.length >= ${pattern.elements.length})`);
+        return pattern.rest ? null : { property: '.length', value: String(pattern.elements.length) };
+      default:
+        return null;
+    }
+  }
+
+  private emitMatchSwitch(arms: ast.MatchArm[], property: string, tail: Tail): void {
+    // Arms grouped by the value they require, in order of first appearance
+    const cases = new Map<string, ast.MatchArm[]>();
+    for (const arm of arms) {
+      const { value } = this.matchDispatch(arm.pattern)!;
+      const group = cases.get(value);
+      if (group) {
+        group.push(arm);
+      } else {
+        cases.set(value, [arm]);
+      }
+    }
+
+    // A single value is a plain test
+    if (cases.size === 1) {
+      const [[value, group]] = cases;
+      this.writeLine(`if (__subject${property} === ${value}) {`);
+      this.indent++;
+      this.emitMatchArms(group, tail);
+      this.indent--;
+      this.writeLine('}');
+      return;
+    }
+
+    this.writeLine(`switch (__subject${property}) {`);
+    this.indent++;
+    for (const [value, group] of cases) {
+      // Arms bind their variables in blocks of their own, so case clauses
+      // sharing the switch's scope need none
+      this.writeLine(`case ${value}:`);
+      this.indent++;
+      if (!this.emitMatchArms(group, tail)) {
+        this.writeLine('break;');
+      }
+      this.indent--;
+    }
+    this.indent--;
+    this.writeLine('}');
+  }
+
+  /**
+   * Emit arms whose dispatch has already succeeded, stopping after one
+   * that always returns. Returns whether one did.
+   */
+  private emitMatchArms(arms: ast.MatchArm[], tail: Tail): boolean {
+    for (const arm of arms) {
+      if (this.emitMatchArm(arm, true, tail)) return true;
+    }
+    return false;
+  }
+
+  /**
+   * Test the rest of an arm's pattern, bind its variables and deliver its
+   * body to `tail` if the guard holds. `dispatched` means the test on the
+   * subject itself has already been made. Returns whether the arm always
+   * delivers.
+   *
+   * All tests form one short-circuiting condition. A part of the subject
+   * read more than once, such as the payload of a nested constructor, is
+   * stored in a temporary where it is first read, and the bindings after
+   * the condition read it from there.
+   */
+  private emitMatchArm(arm: ast.MatchArm, dispatched: boolean, tail: Tail): boolean {
+    const plan = this.planPattern(arm.pattern);
+    const tests = dispatched ? plan.tests.filter(test => test.path.length > 0) : plan.tests;
+
+    // Count the reads through each part of the subject
+    const reads = new Map<string, number>();
+    for (const { path } of [...tests, ...plan.bindings]) {
+      for (let i = 1; i <= path.length; i++) {
+        const key = path.slice(0, i).join('');
+        reads.set(key, (reads.get(key) ?? 0) + 1);
+      }
+    }
+    const temps = new Map<string, string>();
+    for (const [key, count] of reads) {
+      if (count > 1) temps.set(key, `__t${temps.size}`);
+    }
+    this.matchTemps = Math.max(this.matchTemps, temps.size);
+
+    const assigned = new Set<string>();
+    const read = (path: SubjectPath): string => {
+      let expr = '__subject';
+      for (let i = 1; i <= path.length; i++) {
+        const key = path.slice(0, i).join('');
+        const temp = temps.get(key);
+        if (temp === undefined) {
+          expr += path[i - 1];
+        } else if (assigned.has(key)) {
+          expr = temp;
         } else {
-          this.write(`(${subject}.length === ${pattern.elements.length})`);
+          assigned.add(key);
+          expr = `(${temp} = ${expr}${path[i - 1]})`;
         }
-        break;
-      
-      case 'RecordPattern':
-        this.write('true'); // Records always match structurally
-        break;
-      
-      case 'ConstructorPattern':
-        this.write(`(${subject}.__tag === "${pattern.name.name}")`);
-        break;
-      
-      case 'RestPattern':
-        this.write('true');
-        break;
+      }
+      return expr;
+    };
+
+    const condition = tests.map(test => read(test.path) + test.comparison).join(' && ');
+    // Bindings get a block of their own, so that one named like the
+    // subject does not shadow it where `__subject` is declared
+    const scoped = condition !== '' || plan.bindings.length > 0;
+    if (condition !== '') {
+      this.writeLine(`if (${condition}) {`);
+    } else if (scoped) {
+      this.writeLine('{');
     }
+    if (scoped) this.indent++;
+
+    for (const binding of plan.bindings) {
+      const value = read(binding.path);
+      this.writeLine(binding.rest
+        ? `const ${binding.name} = __lw.drop(${value}, ${binding.rest});`
+        : `const ${binding.name} = ${value};`);
+    }
+
+    if (!arm.guard) {
+      this.emitTail(arm.body, tail);
+    } else if (tail.kind === 'return' && !this.lowersToStatements(arm.body) && !tail.loop?.paths.has(arm.body)) {
+      this.write(this.getIndent());
+      this.write('if (');
+      this.emitExpression(arm.guard);
+      this.write(') return ');
+      this.emitExpression(arm.body);
+      this.write(';\n');
+    } else {
+      this.write(this.getIndent());
+      this.write('if (');
+      this.emitExpression(arm.guard);
+      this.write(') {\n');
+      this.indent++;
+      this.emitTail(arm.body, tail, true);
+      this.indent--;
+      this.writeLine('}');
+    }
+
+    if (scoped) {
+      this.indent--;
+      this.writeLine('}');
+    }
+    return condition === '' && !arm.guard;
   }
 
-  private emitPatternBindings(pattern: ast.Pattern, subject: string): void {
+  /**
+   * Collect the tests a pattern makes on the value at `path` and the
+   * variables it binds, in an order where every test only reads parts of
+   * the value whose shape earlier tests have established
+   */
+  private planPattern(
+    pattern: ast.Pattern,
+    path: SubjectPath = [],
+    plan: PatternPlan = { tests: [], bindings: [] }
+  ): PatternPlan {
     switch (pattern.kind) {
       case 'IdentifierPattern':
-        this.writeLine(`const ${pattern.name} = ${subject};`);
+        plan.bindings.push({ name: pattern.name, path });
         break;
-      
-      case 'ListPattern':
+
+      case 'LiteralPattern':
+        plan.tests.push({ path, comparison: ` === ${JSON.stringify(pattern.value)}` });
+        break;
+
+      case 'ListPattern': {
+        const length = pattern.elements.length;
+        plan.tests.push({ path, comparison: `.length ${pattern.rest ? '>=' : '==='} ${length}` });
         pattern.elements.forEach((elem, i) => {
-          this.emitPatternBindings(elem, `${subject}[${i}]`);
+          this.planPattern(elem, [...path, `.at(${i})`], plan);
         });
         if (pattern.rest) {
-          this.writeLine(`const ${pattern.rest.name} = ${subject}.slice(${pattern.elements.length});`);
+          // A view sharing the subject's elements rather than a copy
+          plan.bindings.push({ name: pattern.rest.name, path, rest: length });
         }
         break;
-      
+      }
+
       case 'RecordPattern':
         for (const field of pattern.fields) {
+          const fieldPath = [...path, `.${field.name.name}`];
           if (field.pattern) {
-            this.emitPatternBindings(field.pattern, `${subject}.${field.name.name}`);
+            this.planPattern(field.pattern, fieldPath, plan);
           } else {
-            this.writeLine(`const ${field.name.name} = ${subject}.${field.name.name};`);
+            plan.bindings.push({ name: field.name.name, path: fieldPath });
           }
         }
         break;
-      
+
       case 'ConstructorPattern':
-        if (pattern.fields && pattern.fields.kind === 'RecordPattern') {
-          this.emitPatternBindings(pattern.fields, `${subject}`);
+        plan.tests.push({ path, comparison: `.__tag === ${JSON.stringify(pattern.name.name)}` });
+        if (pattern.fields?.kind === 'RecordPattern') {
+          // Record payloads are stored on the tagged object itself
+          this.planPattern(pattern.fields, path, plan);
         } else if (pattern.fields) {
-          this.emitPatternBindings(pattern.fields, `${subject}.value`);
+          // The runtime's Error keeps its payload under `error`
+          const payload = pattern.name.name === 'Error' ? '.error' : '.value';
+          this.planPattern(pattern.fields, [...path, payload], plan);
+        }
+        break;
+
+      case 'RestPattern':
+        if (pattern.name) {
+          plan.bindings.push({ name: pattern.name.name, path });
         }
         break;
     }
+    return plan;
   }
 
   private emitDoExpression(doExpr: ast.DoExpression): void {
-    this.write('(async () => {\n');
+    // A block none of whose effects can return a promise has nothing to await
+    const sync = this.syncDo.has(doExpr);
+    this.write(sync ? '(() => {\n' : '(async () => {\n');
     this.indent++;
     
     for (let i = 0; i < doExpr.body.length; i++) {
@@ -548,7 +1092,7 @@ export class Emitter {
           this.write('const ');
           this.emitPattern(stmt.pattern);
           this.write(' = ');
-          if (stmt.isEffect) {
+          if (stmt.isEffect && !sync) {
             this.write('await ');
           }
           this.emitExpression(stmt.value);
@@ -558,7 +1102,7 @@ export class Emitter {
         case 'DoEffectStatement':
           this.write(this.getIndent());
           if (isLast) this.write('return ');
-          this.write('await ');
+          if (!sync) this.write('await ');
           this.emitExpression(stmt.expression);
           this.write(';\n');
           break;
@@ -580,44 +1124,377 @@ export class Emitter {
   private emitBlockExpression(block: ast.BlockExpression): void {
     this.write('(() => {\n');
     this.indent++;
-    
+    this.emitBlockStatements(block, RETURN);
+    this.indent--;
+    this.write(this.getIndent());
+    this.write('})()');
+  }
+
+  private emitBlockStatements(block: ast.BlockExpression, tail: Tail): void {
     for (const stmt of block.statements) {
       this.emitStatement(stmt);
     }
     
     if (block.result) {
-      this.write(this.getIndent());
-      this.write('return ');
-      this.emitExpression(block.result);
-      this.write(';\n');
+      this.emitTail(block.result, tail);
+    } else if (tail.kind === 'return') {
+      // Leaves a match arm instead of falling through to the next one
+      this.writeLine('return;');
+    } else {
+      this.writeLine(`${tail.name} = undefined;`);
+      this.writeLine(`break ${tail.label};`);
     }
-    
-    this.indent--;
-    this.write(this.getIndent());
-    this.write('})()');
   }
 
   private emitProvideExpression(provide: ast.ProvideExpression): void {
     this.write('(() => {\n');
     this.indent++;
-    
+    this.emitProvideStatements(provide, RETURN);
+    this.indent--;
+    this.write(this.getIndent());
+    this.write('})()');
+  }
+
+  private emitProvideStatements(provide: ast.ProvideExpression, tail: Tail): void {
     for (const provision of provide.provisions) {
       this.write(this.getIndent());
       this.write(`const ${provision.name.name} = `);
       this.emitExpression(provision.value);
       this.write(';\n');
     }
-    
-    this.write(this.getIndent());
-    this.write('return ');
-    this.emitExpression(provide.body);
-    this.write(';\n');
-    
+
+    this.emitTail(provide.body, tail);
+  }
+
+  // ===========================================================================
+  // Statement Lowering
+  // ===========================================================================
+
+  /**
+   * Whether an expression has a statement form that saves allocating and
+   * calling a closure
+   */
+  private lowersToStatements(expr: ast.Expression): boolean {
+    if (!this.options.lowerToStatements) return false;
+
+    switch (expr.kind) {
+      case 'MatchExpression':
+      case 'BlockExpression':
+      case 'ProvideExpression':
+        return true;
+      case 'IfExpression':
+        return this.lowersToStatements(expr.thenBranch) || this.lowersToStatements(expr.elseBranch);
+      case 'CallExpression':
+      case 'PipelineExpression':
+        return this.fusion.has(expr);
+      default:
+        return false;
+    }
+  }
+
+  /**
+   * Emit statements computing `expr` and delivering its value to `tail`.
+   * Declarations they make get a block of their own unless `inBlock` says
+   * the caller has just opened one for them.
+   */
+  private emitTail(expr: ast.Expression, tail: Tail, inBlock = false): void {
+    const loop = tail.kind === 'return' ? tail.loop : undefined;
+    if (loop && expr.kind === 'CallExpression') {
+      const call = loop.calls.get(expr);
+      if (call) {
+        this.emitTailCall(expr, loop, call);
+        return;
+      }
+    }
+
+    if (!this.lowersToStatements(expr) && !loop?.paths.has(expr)) {
+      this.write(this.getIndent());
+      if (tail.kind === 'return') {
+        this.write('return ');
+        this.emitExpression(expr);
+        this.write(';\n');
+      } else {
+        this.write(`${tail.name} = `);
+        this.emitExpression(expr);
+        this.write(`;\n${this.getIndent()}break ${tail.label};\n`);
+      }
+      return;
+    }
+
+    if (expr.kind === 'BlockExpression' && expr.statements.length === 0 && expr.result) {
+      this.emitTail(expr.result, tail, inBlock);
+      return;
+    }
+
+    if (expr.kind === 'IfExpression') {
+      this.write(this.getIndent());
+      this.write('if (');
+      this.emitExpression(expr.condition);
+      this.write(') {\n');
+      this.indent++;
+      this.emitTail(expr.thenBranch, tail, true);
+      this.indent--;
+      this.writeLine('} else {');
+      this.indent++;
+      this.emitTail(expr.elseBranch, tail, true);
+      this.indent--;
+      this.writeLine('}');
+      return;
+    }
+
+    if (!inBlock) {
+      this.writeLine('{');
+      this.indent++;
+    }
+    switch (expr.kind) {
+      case 'MatchExpression':
+        this.emitMatchStatements(expr, tail);
+        break;
+      case 'BlockExpression':
+        this.emitBlockStatements(expr, tail);
+        break;
+      case 'ProvideExpression':
+        this.emitProvideStatements(expr, tail);
+        break;
+      default:
+        this.emitFusedLoop(this.fusion.get(expr)!, tail);
+    }
+    if (!inBlock) {
+      this.indent--;
+      this.writeLine('}');
+    }
+  }
+
+  // ===========================================================================
+  // Tail Calls
+  // ===========================================================================
+
+  /**
+   * Emit a function that calls itself in tail position as a loop over its
+   * body, which such calls restart with new parameters
+   */
+  private emitTailLoop(name: string, loop: TailLoop): void {
+    this.writeLine(`const ${name} = (${loop.params.join(', ')}) => {`);
+    this.indent++;
+    this.writeLine('while (true) {');
+    this.indent++;
+    const outerTemps = this.tailTemps;
+    this.tailTemps = 0;
+    this.emitTail(loop.fn.body, { kind: 'return', loop }, true);
+    this.tailTemps = outerTemps;
+    this.indent--;
+    this.writeLine('}');
+    this.indent--;
+    this.writeLine('};');
+  }
+
+  /**
+   * Emit functions calling each other in tail position as one loop over
+   * their bodies, which such calls restart at the body of the function
+   * called. Arguments are passed in `__arg` variables, bound to the
+   * parameters afresh each time a body starts.
+   */
+  private emitTailGroup(group: TailGroup): void {
+    const slots = Math.max(...group.members.map(member => member.params.length));
+    const args = Array.from({ length: slots }, (_, i) => `__arg${i}`);
+    this.writeLine(`const ${group.name} = (${['__call', ...args].join(', ')}) => {`);
+    this.indent++;
+    this.writeLine('while (true) {');
+    this.indent++;
+    this.writeLine('switch (__call) {');
+    this.indent++;
+    group.members.forEach((member, i) => {
+      this.writeLine(`case ${i}: {`);
+      this.indent++;
+      member.params.forEach((param, j) => this.writeLine(`const ${param} = __arg${j};`));
+      this.emitTail(member.fn.body, { kind: 'return', loop: member });
+      this.indent--;
+      this.writeLine('}');
+    });
+    this.indent--;
+    this.writeLine('}');
+    this.indent--;
+    this.writeLine('}');
+    this.indent--;
+    this.writeLine('};');
+  }
+
+  private emitTailCall(call: ast.CallExpression, loop: TailLoop, tailCall: TailCall): void {
+    if (loop.group) {
+      for (const i of tailCall.changed) {
+        this.write(this.getIndent());
+        this.write(`__arg${i} = `);
+        this.emitExpression(call.args[i]!);
+        this.write(';\n');
+      }
+      if (tailCall.target !== loop) {
+        this.writeLine(`__call = ${loop.group.members.indexOf(tailCall.target)};`);
+      }
+    } else if (tailCall.temps) {
+      // Every argument is evaluated before any parameter changes
+      const temps = tailCall.changed.map(() => `__a${this.tailTemps++}`);
+      tailCall.changed.forEach((i, j) => {
+        this.write(this.getIndent());
+        this.write(`const ${temps[j]} = `);
+        this.emitExpression(call.args[i]!);
+        this.write(';\n');
+      });
+      tailCall.changed.forEach((i, j) => this.writeLine(`${loop.params[i]} = ${temps[j]};`));
+    } else {
+      for (const i of tailCall.changed) {
+        this.write(this.getIndent());
+        this.write(`${loop.params[i]} = `);
+        this.emitExpression(call.args[i]!);
+        this.write(';\n');
+      }
+    }
+    this.writeLine('continue;');
+  }
+
+  // ===========================================================================
+  // Fused Loops
+  // ===========================================================================
+
+  private emitFusedExpression(loop: FusedLoop): void {
+    this.write('(() => {\n');
+    this.indent++;
+    this.emitFusedLoop(loop, RETURN);
     this.indent--;
     this.write(this.getIndent());
     this.write('})()');
   }
 
+  /**
+   * Emit a chain of list combinators as one loop over its source that
+   * takes each element through every stage in turn. Lambdas with plain
+   * parameters and an expression body are inlined; other functions are
+   * evaluated once before the loop.
+   */
+  private emitFusedLoop(loop: FusedLoop, tail: Tail): void {
+    const n = this.loops++;
+    const list = `__xs${n}`;
+    const value = `__v${n}`;
+    const acc = `__acc${n}`;
+    const index = `__i${n}`;
+
+    this.write(this.getIndent());
+    this.write(`const ${list} = `);
+    this.emitExpression(loop.source);
+    this.write(';\n');
+
+    const fns = [...loop.stages.map(stage => stage.fn), ...(loop.sink.kind === 'fold' ? [loop.sink.fn] : [])];
+    const hoisted = fns.map((fn, i) => {
+      if (this.inlinesInLoop(fn)) return null;
+      if (fn.kind === 'Identifier') return this.sanitizeIdentifier(fn.name);
+      const name = `__f${n}_${i}`;
+      this.write(this.getIndent());
+      this.write(`const ${name} = `);
+      this.emitExpression(fn);
+      this.write(';\n');
+      return name;
+    });
+
+    switch (loop.sink.kind) {
+      case 'list':
+        this.writeLine(`const ${acc} = [];`);
+        break;
+      case 'sum':
+      case 'length':
+        this.writeLine(`let ${acc} = 0;`);
+        break;
+      case 'fold':
+        this.write(this.getIndent());
+        this.write(`let ${acc} = `);
+        this.emitExpression(loop.sink.init);
+        this.write(';\n');
+        break;
+    }
+
+    this.writeLine(`for (let ${index} = 0; ${index} < ${list}.length; ${index}++) {`);
+    this.indent++;
+    this.writeLine(`let ${value} = ${list}.at(${index});`);
+    loop.stages.forEach((stage, i) => {
+      this.emitLoopCall(stage.fn, hoisted[i] ?? null, [value], emitResult => {
+        this.write(this.getIndent());
+        if (stage.kind === 'map') {
+          this.write(`${value} = `);
+          emitResult();
+          this.write(';\n');
+        } else {
+          this.write('if (!(');
+          emitResult();
+          this.write(')) continue;\n');
+        }
+      });
+    });
+    switch (loop.sink.kind) {
+      case 'list':
+        this.writeLine(`${acc}.push(${value});`);
+        break;
+      case 'sum':
+        this.writeLine(`${acc} += ${value};`);
+        break;
+      case 'length':
+        this.writeLine(`${acc}++;`);
+        break;
+      case 'fold':
+        this.emitLoopCall(loop.sink.fn, hoisted[loop.stages.length] ?? null, [acc, value], emitResult => {
+          this.write(this.getIndent());
+          this.write(`${acc} = `);
+          emitResult();
+          this.write(';\n');
+        });
+        break;
+    }
+    this.indent--;
+    this.writeLine('}');
+
+    if (tail.kind === 'return') {
+      this.writeLine(`return ${acc};`);
+    } else {
+      this.writeLine(`${tail.name} = ${acc};`);
+      this.writeLine(`break ${tail.label};`);
+    }
+    this.loops--;
+  }
+
+  /**
+   * Whether a stage function can be written into the loop body: a lambda
+   * binding plain names, whose body is a single expression
+   */
+  private inlinesInLoop(fn: ast.Expression): boolean {
+    return fn.kind === 'FunctionExpression' &&
+      fn.params.every(p => p.kind === 'IdentifierPattern' || p.kind === 'WildcardPattern') &&
+      !this.lowersToStatements(fn.body);
+  }
+
+  /**
+   * Emit a call of a stage function inside a fused loop, handing `use` a
+   * writer for the result. An inlined lambda gets a block binding its
+   * parameters to the arguments.
+   */
+  private emitLoopCall(
+    fn: ast.Expression,
+    hoisted: string | null,
+    args: string[],
+    use: (emitResult: () => void) => void
+  ): void {
+    if (hoisted !== null) {
+      use(() => this.write(`${hoisted}(${args.join(', ')})`));
+      return;
+    }
+
+    const lambda = fn as ast.FunctionExpression;
+    this.writeLine('{');
+    this.indent++;
+    lambda.params.forEach((param, i) => {
+      if (param.kind === 'IdentifierPattern') this.writeLine(`const ${param.name} = ${args[i]};`);
+    });
+    use(() => this.emitExpression(lambda.body));
+    this.indent--;
+    this.writeLine('}');
+  }
+
   private emitPattern(pattern: ast.Pattern): void {
     switch (pattern.kind) {
       case 'IdentifierPattern':
@@ -690,8 +1567,16 @@ export class Emitter {
   }
 }
 
-export function emit(program: ast.Program, options?: EmitOptions): EmitResult {
+export function emit(
+  program: ast.Program,
+  options?: EmitOptions,
+  reuse?: Map<ast.Module | ast.Statement, string>,
+  fusion?: FusionPlan,
+  parallel?: ParallelPlan,
+  tailCalls?: TailCallPlan,
+  syncDo?: SyncDoPlan
+): EmitResult {
   const emitter = new Emitter(options);
-  return emitter.emit(program);
+  return emitter.emit(program, reuse, fusion, parallel, tailCalls, syncDo);
 }
 
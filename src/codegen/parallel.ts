@@ -0,0 +1,409 @@
+/**
+ * Parallel stage runtime for Lambdawg
+ *
+ * The JavaScript emitted as `__lw.parallel` for programs with stages
+ * such as `xs |> @parallel(minSize: 1000) map(f, _)`. It runs the stage
+ * over chunks of the list on a pool of worker threads, scheduled by work
+ * stealing:
+ *
+ * - Every thread, the calling one included, owns a deque of chunk tasks
+ *   in shared memory. A stage pushes its chunks onto the deque of the
+ *   thread running it, which works through them from the bottom while
+ *   idle threads steal from the top.
+ * - A stage started inside another one, on any thread, pushes onto that
+ *   thread's deque in the same way, so nested pipelines spread over all
+ *   cores. A thread waiting for stolen chunks steals other work
+ *   meanwhile instead of blocking, so nesting cannot deadlock the pool.
+ * - Each chunk is serialized once into its owner's arena, a growable
+ *   SharedArrayBuffer, and only a thread that steals it deserializes it.
+ *   Results come back over a message channel between the two threads.
+ *   List views in either are copied into arrays first, since
+ *   serializing drops their class.
+ * - Lists the checker proved to hold Int or Float are instead copied once
+ *   into a Float64Array in the arena, which thieves read in place, and
+ *   such results of a `map` are written in place to another. A `filter`
+ *   writes a flag per element, so the elements it keeps never travel.
+ *
+ * Without a `chunkSize` hint, chunks are sized from the time the stage
+ * takes on a prefix of the list, so that each carries about a
+ * millisecond of work, and stages too cheap to gain from workers finish
+ * on the calling thread. Lists below the stage's `minSize`, functions or
+ * values that cannot be serialized, and hosts without worker_threads or a
+ * spare core run sequentially instead. A chunk that throws makes the
+ * whole stage run again sequentially, so that its error is thrown as
+ * usual.
+ */
+
+/**
+ * The source of the `__lw.parallel` helper. Workers evaluate `runtime`,
+ * the helpers emitted before it, to call the stage functions they get as
+ * source.
+ */
+export function parallelRuntime(runtime: string): string {
+  return `// Parallel stages
+__lw.parallel = ((runtime) => {
+  const threads = typeof process === "object" ? process.getBuiltinModule?.("node:worker_threads") : undefined;
+  const size = threads ? process.getBuiltinModule("node:os").availableParallelism() : 1;
+  const sequential = (op, fn, list) => __lw[op](fn, list);
+  if (size < 2) return sequential;
+  // Tasks each thread may have queued or running at once
+  const capacity = 1024;
+
+  // One scheduler runs on every thread, with the same shared memory
+  const scheduler = ({ self, shared, arenas, ports, capacity, runtime }) => {
+    const v8 = process.getBuiltinModule("node:v8");
+    const { receiveMessageOnPort } = process.getBuiltinModule("node:worker_threads");
+    // Chunks sized from a timed sample aim for this much work each, and
+    // elements cheaper than copying them to a worker and back stay here (ms)
+    const chunkTime = 1;
+    const sendTime = 0.0001;
+
+    // shared: [wake-up signal, stage serial, deques..., tasks...]
+    // deque: [lock, top, bottom, task ids...]
+    // task: [state, thief, stage serial, header at, header length, start, count, chunk at, chunk length]
+    const QUEUED = 1, RUNNING = 2, DONE = 3, FAILED = 4;
+    const deque = (thread) => 2 + thread * (3 + capacity);
+    const task = (id) => 2 + arenas.length * (3 + capacity) + id * 9;
+
+    const lock = (at) => {
+      while (Atomics.compareExchange(shared, at, 0, 1) !== 0);
+    };
+    const push = (id) => {
+      const at = deque(self);
+      lock(at);
+      shared[at + 3 + shared[at + 2] % capacity] = id;
+      shared[at + 2]++;
+      Atomics.store(shared, at, 0);
+    };
+    // Take the bottom task of this thread's deque if it is one of the stage's
+    const pop = (serial) => {
+      const at = deque(self);
+      lock(at);
+      let id = -1;
+      if (shared[at + 2] > shared[at + 1]) {
+        const bottom = shared[at + 3 + (shared[at + 2] - 1) % capacity];
+        if (shared[task(bottom) + 2] === serial) {
+          id = bottom;
+          shared[at + 2]--;
+          shared[task(id)] = RUNNING;
+          if (shared[at + 2] === shared[at + 1]) shared[at + 1] = shared[at + 2] = 0;
+        }
+      }
+      Atomics.store(shared, at, 0);
+      return id;
+    };
+    const steal = (victim) => {
+      const at = deque(victim);
+      if (Atomics.load(shared, at + 2) <= Atomics.load(shared, at + 1)) return -1;
+      lock(at);
+      let id = -1;
+      if (shared[at + 2] > shared[at + 1]) {
+        id = shared[at + 3 + shared[at + 1] % capacity];
+        shared[at + 1]++;
+        shared[task(id)] = RUNNING;
+        shared[task(id) + 1] = self;
+        if (shared[at + 2] === shared[at + 1]) shared[at + 1] = shared[at + 2] = 0;
+      }
+      Atomics.store(shared, at, 0);
+      return id;
+    };
+
+    // Chunks and stage headers of this thread's running stages, in stack order
+    const arena = arenas[self];
+    const bytes = new Uint8Array(arena);
+    let top = 0;
+    const reserve = (length) => {
+      if (top + length > arena.byteLength) {
+        arena.grow(Math.min(arena.maxByteLength, Math.max(top + length, arena.byteLength * 2)));
+      }
+      top += length;
+      return top - length;
+    };
+    // List views lose their class when serialized, so they travel as
+    // arrays: any object that is iterable without being an array
+    const plain = (value) => {
+      if (typeof value !== "object" || value === null || ArrayBuffer.isView(value)) return value;
+      const array = Array.isArray(value);
+      if (!array && typeof value[Symbol.iterator] === "function") return Array.from(value, plain);
+      // Copied only once something in it changes
+      let copy = value;
+      const replace = (key) => {
+        const x = plain(value[key]);
+        if (x === value[key]) return;
+        if (copy === value) copy = array ? value.slice() : { ...value };
+        copy[key] = x;
+      };
+      if (array) {
+        for (let i = 0; i < value.length; i++) replace(i);
+      } else {
+        for (const key of Object.keys(value)) replace(key);
+      }
+      return copy;
+    };
+    const write = (value) => {
+      const data = v8.serialize(plain(value));
+      const at = reserve(data.length);
+      bytes.set(data, at);
+      return [at, data.length];
+    };
+    const read = (thread, at, length) => v8.deserialize(new Uint8Array(arenas[thread], at, length));
+    const view = (Type, length) => {
+      reserve((8 - top % 8) % 8);
+      return new Type(arena, reserve(length * Type.BYTES_PER_ELEMENT), length);
+    };
+    // Copy a list of numbers from an index into a view of the same length,
+    // unless it turns out to hold something else
+    const share = (list, from) => {
+      const numbers = view(Float64Array, list.length);
+      for (let i = from; i < list.length; i++) {
+        const x = list[i];
+        if (typeof x !== "number") return null;
+        numbers[i] = x;
+      }
+      return numbers;
+    };
+
+    const apply = (op, fn, items) => op === "map" ? items.map((x) => fn(x)) : items.filter((x) => fn(x));
+    // Run a stage on count items from items[from], returning the results or,
+    // given a shared view, writing them to it from out[to]
+    const compute = (op, fn, items, from, count, out, to) => {
+      if (out === null) {
+        const results = [];
+        for (let i = from; i < from + count; i++) {
+          if (op === "map") results.push(fn(items[i]));
+          else if (fn(items[i])) results.push(items[i]);
+        }
+        return results;
+      }
+      for (let i = 0; i < count; i++) {
+        const result = fn(items[from + i]);
+        if (op === "filter") {
+          out[to + i] = result ? 1 : 0;
+        } else if (typeof result === "number") {
+          out[to + i] = result;
+        } else {
+          throw new TypeError("Expected a number");
+        }
+      }
+      return null;
+    };
+    const makers = new Map();
+    const compile = (source, names) => {
+      const key = names.join(",") + ":" + source;
+      let make = makers.get(key);
+      if (!make) {
+        make = new Function("__run", runtime + "__lw.parallel = __run;\\n" +
+          "return (" + names.join(", ") + ") => (" + source + ");")(run);
+        makers.set(key, make);
+      }
+      return make;
+    };
+
+    // Run a task stolen from another thread and send its result back
+    const headers = new Map();
+    const runStolen = (id) => {
+      const owner = Math.floor(id / capacity);
+      const at = task(id);
+      try {
+        let header = headers.get(shared[at + 2]);
+        if (!header) {
+          const { op, source, names, values, length, numbers, out } = read(owner, shared[at + 3], shared[at + 4]);
+          header = {
+            op,
+            fn: compile(source, names)(...values),
+            numbers: numbers === -1 ? null : new Float64Array(arenas[owner], numbers, length),
+            out: out === -1 ? null : new (op === "map" ? Float64Array : Uint8Array)(arenas[owner], out, length),
+          };
+          if (headers.size >= 16) headers.delete(headers.keys().next().value);
+          headers.set(shared[at + 2], header);
+        }
+        const { op, fn, numbers, out } = header;
+        const start = shared[at + 5], count = shared[at + 6];
+        const items = numbers === null
+          ? compute(op, fn, read(owner, shared[at + 7], shared[at + 8]), 0, count, out, start)
+          : compute(op, fn, numbers, start, count, out, start);
+        if (out === null) ports[owner].postMessage({ id, items: plain(items) });
+        Atomics.store(shared, at, DONE);
+      } catch {
+        Atomics.store(shared, at, FAILED);
+      }
+      Atomics.notify(shared, at);
+    };
+    const help = () => {
+      for (let i = 1; i < arenas.length; i++) {
+        const victim = (self + i) % arenas.length;
+        const id = steal(victim);
+        if (id !== -1) {
+          runStolen(id);
+          return true;
+        }
+      }
+      return false;
+    };
+
+    // Results of this thread's tasks sent by the threads that stole them
+    const inbox = new Map();
+    const receive = (id) => {
+      const port = ports[shared[task(id) + 1]];
+      while (!inbox.has(id)) {
+        // Sent before the task was marked done, so there is one
+        const { id: done, items } = receiveMessageOnPort(port).message;
+        inbox.set(done, items);
+      }
+      const items = inbox.get(id);
+      inbox.delete(id);
+      return items;
+    };
+
+    const free = Array.from({ length: capacity }, (_, i) => self * capacity + capacity - 1 - i);
+    const unsendable = new Set();
+
+    const run = (op, fn, list, captures, hint, numeric) => {
+      const source = String(fn);
+      if (list.length < (hint.minSize ?? 1000) || unsendable.has(source) || free.length === 0) {
+        return sequential(op, fn, list);
+      }
+      // Chunks of views are copied out of them
+      if (!Array.isArray(list)) list = [...list];
+
+      const head = [];
+      let from = 0;
+      let chunkSize = hint.chunkSize;
+      if (chunkSize === undefined) {
+        // Time the stage on a growing prefix of the list, run here, and
+        // keep the cost per element of the last and most warmed up batch
+        let cost = 0;
+        for (let elapsed = 0; from < list.length / 8 && elapsed < chunkTime;) {
+          const to = Math.min(list.length, Math.max(16, from * 2));
+          const begin = performance.now();
+          for (let i = from; i < to; i++) {
+            if (op === "map") head.push(fn(list[i]));
+            else if (fn(list[i])) head.push(list[i]);
+          }
+          const took = performance.now() - begin;
+          cost = took / (to - from);
+          elapsed += took;
+          from = to;
+        }
+        const rest = list.length - from;
+        if (cost < sendTime || cost * rest < chunkTime * arenas.length) {
+          return head.concat(apply(op, fn, list.slice(from)));
+        }
+        chunkSize = Math.min(Math.ceil(rest / arenas.length), Math.ceil(chunkTime / cost));
+      }
+      chunkSize = Math.max(1, chunkSize, Math.ceil((list.length - from) / free.length));
+
+      const mark = top;
+      const serial = Atomics.add(shared, 1, 1);
+      const ids = [];
+      let out = null;
+      try {
+        const numbers = numeric.list ? share(list, from) : null;
+        if (op === "filter") out = view(Uint8Array, list.length);
+        else if (numeric.results) out = view(Float64Array, list.length);
+        const [headerAt, headerLength] = write({
+          op,
+          source,
+          names: Object.keys(captures),
+          values: Object.values(captures),
+          length: list.length,
+          numbers: numbers === null ? -1 : numbers.byteOffset,
+          out: out === null ? -1 : out.byteOffset,
+        });
+        for (let start = from; start < list.length; start += chunkSize) {
+          const count = Math.min(chunkSize, list.length - start);
+          const [at, length] = numbers === null ? write(list.slice(start, start + count)) : [0, 0];
+          const id = free.pop();
+          shared.set([QUEUED, self, serial, headerAt, headerLength, start, count, at, length], task(id));
+          ids.push(id);
+        }
+      } catch (error) {
+        // Functions and other values that cannot be serialized
+        if (error?.name === "DataCloneError") unsendable.add(source);
+        free.push(...ids);
+        top = mark;
+        return head.concat(apply(op, fn, list.slice(from)));
+      }
+      for (const id of ids) push(id);
+      Atomics.add(shared, 0, 1);
+      Atomics.notify(shared, 0);
+
+      const results = new Array(ids.length);
+      const index = new Map(ids.map((id, i) => [id, i]));
+      let complete = true;
+      for (let id = pop(serial); id !== -1; id = pop(serial)) {
+        const i = index.get(id);
+        try {
+          if (complete) results[i] = compute(op, fn, list, shared[task(id) + 5], shared[task(id) + 6], out, shared[task(id) + 5]);
+        } catch {
+          complete = false;
+        }
+        shared[task(id)] = DONE;
+        results[i] ??= null;
+      }
+      // Wait for the stolen chunks, running other tasks meanwhile
+      for (let i = 0; i < ids.length; i++) {
+        if (results[i] !== undefined) continue;
+        const at = task(ids[i]);
+        while (Atomics.load(shared, at) === RUNNING) {
+          if (!help()) Atomics.wait(shared, at, RUNNING, 1);
+        }
+        if (Atomics.load(shared, at) !== DONE) complete = false;
+        else results[i] = out === null ? receive(ids[i]) : null;
+      }
+      for (const id of ids) shared[task(id)] = 0;
+      free.push(...ids);
+      if (complete && out !== null) {
+        for (let i = from; i < list.length; i++) {
+          if (op === "map") head.push(out[i]);
+          else if (out[i]) head.push(list[i]);
+        }
+      }
+      top = mark;
+      if (!complete) return sequential(op, fn, list);
+      return out === null ? head.concat(results.flat()) : head;
+    };
+
+    // Workers spend their life stealing, and sleep while there is nothing
+    const idle = () => {
+      for (;;) {
+        const signal = Atomics.load(shared, 0);
+        if (!help()) Atomics.wait(shared, 0, signal);
+      }
+    };
+    return { run, idle };
+  };
+
+  const start = () => {
+    const shared = new Int32Array(new SharedArrayBuffer(4 * (2 + size * (3 + capacity) + size * capacity * 9)));
+    const arenas = Array.from({ length: size }, () => new SharedArrayBuffer(1 << 16, { maxByteLength: 1 << 30 }));
+    // ports[a][b] talks from thread a to thread b
+    const ports = Array.from({ length: size }, () => []);
+    for (let a = 0; a < size; a++) {
+      for (let b = a + 1; b < size; b++) {
+        const { port1, port2 } = new threads.MessageChannel();
+        ports[a][b] = port1;
+        ports[b][a] = port2;
+      }
+    }
+    const source = "(" + scheduler + ")(process.getBuiltinModule(\\"node:worker_threads\\").workerData).idle()";
+    for (let self = 1; self < size; self++) {
+      const worker = new threads.Worker(source, {
+        eval: true,
+        workerData: { self, shared, arenas, ports: ports[self], capacity, runtime },
+        transferList: ports[self].filter(Boolean),
+      });
+      worker.unref();
+    }
+    return scheduler({ self: 0, shared, arenas, ports: ports[0], capacity, runtime }).run;
+  };
+
+  let run = null;
+  return (op, fn, list, captures, hint, numeric = {}) => {
+    if (list.length < (hint.minSize ?? 1000)) return sequential(op, fn, list);
+    run ??= start();
+    return run(op, fn, list, captures, hint, numeric);
+  };
+})(${JSON.stringify(runtime)});
+`;
+}
@@ -1,5 +1,9 @@
 import { describe, it, expect } from 'vitest';
-import { compile, check } from './compiler.js';
+import { compile, check, toChromeTrace } from './compiler.js';
+import { tokenize } from './lexer/index.js';
+import { parse } from './parser/index.js';
+import type { LetStatement, FunctionExpression } from './parser/index.js';
+import { typeCheck, prune, typeToString } from './types/index.js';
 
 describe('Compiler', () => {
   describe('compile', () => {
@@ -27,7 +31,7 @@ describe('Compiler', () => {
         console.log('Pipeline errors:', result.errors);
       }
       expect(result.success).toBe(true);
-      expect(result.code).toContain('__lw.pipe');
+      expect(result.code).toContain('const doubled = map((x) => (x * 2), nums)');
     });
 
     it('compiles an if expression', () => {
@@ -49,7 +53,73 @@ describe('Compiler', () => {
         console.log('Do block errors:', result.errors);
       }
       expect(result.success).toBe(true);
-      expect(result.code).toContain('async');
+      // Nothing in it can return a promise
+      expect(result.code).toContain('const main = (arg) => (() => {');
+    });
+
+    it('keeps do blocks async only where an effect may return a promise', () => {
+      const source = `
+        let greet = (console, name) => do {
+          do! console.print("hi " + name)
+          name
+        }
+        let countdown = (n) => provide out = { print: (x) => show(x) } in {
+          do {
+            do! out.print(n)
+            if n == 0 then 0 else countdown(n - 1)
+          }
+        }
+        let slow = (file, n) => provide out = { print: (x) => do { do! file.read(x) } } in {
+          do {
+            do! out.print(n)
+            n
+          }
+        }
+        let load = (file, path) => do {
+          let text = do! file.read(path)
+          length(text)
+        }
+        let report = (file, path) => do {
+          let size = do! load(file, path)
+          size + 1
+        }
+        let double = (n) => n * 2
+        let twice = (n) => do {
+          let doubled = do! double(n)
+          doubled
+        }
+      `;
+      const result = compile(source);
+
+      expect(result.success).toBe(true);
+      expect(result.code).toContain('const twice = (n) => (() => {\n  const doubled = double(n);');
+      expect(result.code).toContain('await console.print(("hi " + name));');
+      expect(result.code).toContain('return (() => {\n    out.print(n);');
+      expect(result.code).toContain('await out.print(n);');
+      expect(result.code).toContain('const text = await file.read(path);');
+      expect(result.code).toContain('const size = await load(file, path);');
+      expect(result.code.match(/async/g)).toHaveLength(5);
+      const [twice, countdown] = new Function(`${result.code}\nreturn [twice, countdown];`)();
+      expect(twice(4)).toBe(8);
+      expect(countdown(3)).toBe(0);
+
+      const main = 'let main with console = () => do {\n  do! console.print("hello")\n  1\n}';
+      const ambient = compile(main);
+      expect(ambient.success).toBe(true);
+      expect(ambient.code).toContain('const main = (console) => () => (() => {\n  console.print("hello");');
+      const printed: string[] = [];
+      const run = new Function(`${ambient.code}\nreturn main;`)();
+      expect(run({ print: (text: string) => printed.push(text) })()).toBe(1);
+      expect(printed).toEqual(['hello']);
+      expect(compile(main, { syncEffects: [] }).code).toContain('await console.print("hello");');
+
+      const hello = 'let hello = (name) => do {\n  do! console.print(name)\n  name\n}';
+      const host = compile(hello, { skipTypeCheck: true });
+      expect(host.code).toContain('const hello = (name) => (() => {\n  console.print(name);');
+      const awaited = compile(hello, { skipTypeCheck: true, syncEffects: [] });
+      expect(awaited.code).toContain('await console.print(name);');
+      const off = compile(source, { syncDoBlocks: false });
+      expect(off.code.match(/async/g)).toHaveLength(7);
     });
 
     it('compiles pattern matching', () => {
@@ -65,6 +135,302 @@ describe('Compiler', () => {
       expect(result.code).toContain('__subject');
     });
 
+    it('dispatches on constructor tags with one switch', () => {
+      const result = compile(`
+        let route = (r) => match r {
+          Ok(n) if n > 10 => n
+          Error(e) => e
+          Ok(n) => n + 1
+        }
+      `);
+
+      expect(result.success).toBe(true);
+      const route = result.code.slice(result.code.indexOf('const route'));
+      expect(route.match(/__tag/g)?.length).toBe(1);
+      const [run, ok, error] = new Function(`${result.code}\nreturn [route, Ok, Error];`)();
+      expect(run(ok(20))).toBe(20);
+      expect(run(ok(5))).toBe(6);
+      expect(run(error('failed'))).toBe('failed');
+    });
+
+    it('binds a name in a catch-all arm without shadowing the subject', () => {
+      const result = compile(`
+        let size = (xs) => match xs {
+          [] => 0
+          xs => length(xs)
+        }
+      `);
+
+      expect(result.success).toBe(true);
+      const size = new Function(`${result.code}\nreturn size;`)();
+      expect(size([])).toBe(0);
+      expect(size([1, 2, 3])).toBe(3);
+    });
+
+    it('tests nested patterns', () => {
+      const result = compile(`
+        let describe = (o) => match o {
+          Some(Ok(0)) => "zero"
+          Some(Ok(n)) => "ok"
+          Some(Error(e)) => e
+          None => "none"
+        }
+      `);
+
+      expect(result.success).toBe(true);
+      expect(result.code).toContain('(__t0 = __subject.value).__tag === "Ok" && __t0.value === 0');
+      const [run, some, ok, error, none] = new Function(
+        `${result.code}\nreturn [describe, Some, Ok, Error, None];`
+      )();
+      expect(run(some(ok(0)))).toBe('zero');
+      expect(run(some(ok(1)))).toBe('ok');
+      expect(run(some(error('failed')))).toBe('failed');
+      expect(run(none)).toBe('none');
+    });
+
+    it('lowers returned and bound matches and blocks to statements', () => {
+      const source = `
+        let total = (xs) => {
+          let first = match xs {
+            [a, ...rest] => a
+            _ => 0
+          }
+          first + length(xs)
+        }
+      `;
+      const result = compile(source);
+
+      expect(result.success).toBe(true);
+      expect(result.code).not.toContain('(() =>');
+      const total = new Function(`${result.code}\nreturn total;`)();
+      expect(total([5, 1])).toBe(7);
+      expect(total([])).toBe(0);
+
+      const wrapped = compile(source, { emit: { lowerToStatements: false } });
+      expect(wrapped.code).toContain('(() =>');
+    });
+
+    it('lowers function bodies that rebind a parameter name', () => {
+      const result = compile(`
+        let double = (n) => match n {
+          0 => 1
+          n => n * 2
+        }
+        let reset = (x) => {
+          let x = 1
+          x + 1
+        }
+        let given = (y) => provide y = 5 in { y * 3 }
+      `);
+
+      expect(result.success).toBe(true);
+      expect(result.code).not.toContain('(() =>');
+      const [double, reset, given] = new Function(`${result.code}\nreturn [double, reset, given];`)();
+      expect(double(0)).toBe(1);
+      expect(double(4)).toBe(8);
+      expect(reset(10)).toBe(2);
+      expect(given(1)).toBe(15);
+    });
+
+    it('takes the tail of a list as a view sharing its elements', () => {
+      const source = `
+        let rest = (xs) => match tail(xs) {
+          Some(ys) => ys
+          None => []
+        }
+        let second = (xs) => match rest(xs) {
+          [y, ...more] => y
+          _ => 0
+        }
+        let third = (xs) => rest(rest(xs))[0]
+        let before = (xs) => rest(xs)[-1]
+        let last = (xs) => xs[-1]
+        let total = (xs) => rest(xs) |> map((x) => x * 2, _) |> sum(_)
+      `;
+      const result = compile(source);
+
+      expect(result.success).toBe(true);
+      const [rest, second, third, before, last, total, show] = new Function(
+        `${result.code}\nreturn [rest, second, third, before, last, total, show];`
+      )();
+      const xs = [1, 2, 3];
+      const ys = rest(xs);
+      expect(ys.items).toBe(xs);
+      expect(rest(ys).items).toBe(xs);
+      expect([...ys]).toEqual([2, 3]);
+      expect([ys[0], ys[1], ys[2], ys[-1]]).toEqual([2, 3, undefined, undefined]);
+      expect(Array.isArray(ys)).toBe(false);
+      expect(Array.from(ys)).toEqual([2, 3]);
+
+      const exported = compile(`
+        module lists {
+          let rest = (xs) => match xs {
+            [x, ...more] => more
+            _ => xs
+          }
+        }
+      `);
+      expect(exported.success).toBe(true);
+      const lists = new Function(`${exported.code}\nreturn lists;`)();
+      const more = lists.rest([4, 5, 6]);
+      expect([more[0], more[1], more.length]).toEqual([5, 6, 2]);
+      expect(show(rest(ys))).toBe('[3]');
+      expect(rest(rest(rest(ys))).length).toBe(0);
+      expect(second(xs)).toBe(2);
+      expect(second([1])).toBe(0);
+      expect(third(xs)).toBe(3);
+      expect(before(xs)).toBeUndefined();
+      expect(last(xs)).toBeUndefined();
+      expect(total(xs)).toBe(10);
+    });
+
+    it('binds the rest of a list pattern to a view sharing its elements', () => {
+      const source = `
+        let rest = (xs) => match xs {
+          [x, y, ...more] => more
+          _ => xs
+        }
+      `;
+      const result = compile(source);
+
+      expect(result.success).toBe(true);
+      expect(result.code).toContain('const more = __lw.drop(__subject, 2);');
+      const rest = new Function(`${result.code}\nreturn rest;`)();
+      const xs = [1, 2, 3, 4, 5];
+      expect(rest(xs).items).toBe(xs);
+      expect([...rest(rest(xs))]).toEqual([5]);
+      expect(rest(rest(xs)).items).toBe(xs);
+      expect(rest([1])).toEqual([1]);
+      const more = rest(xs);
+      expect([more[0], more[1], more[2], more[3], more.length]).toEqual([3, 4, 5, undefined, 3]);
+      expect(Array.from(more)).toEqual([3, 4, 5]);
+      expect(JSON.stringify(more)).toBe('[3,4,5]');
+    });
+
+    it('runs functions that call themselves in tail position as loops', () => {
+      const source = `
+        let count = (xs, n) => match xs {
+          [x, ...rest] => count(rest, n + 1)
+          _ => n
+        }
+        let factorial = (n, acc) => if n <= 1 then acc else factorial(n - 1, acc * n)
+        let thunk = (n, f) => if n == 0 then f else thunk(n - 1, (u) => n)
+      `;
+      const result = compile(source);
+
+      expect(result.success).toBe(true);
+      expect(result.code).toContain('const count = (xs, n) => {\n  while (true) {');
+      expect(result.code).toContain('xs = rest;\n      n = (n + 1);\n      continue;');
+      expect(result.code).toContain('const __a0 = (n - 1);\n      const __a1 = (acc * n);');
+      // Its closures would see the parameters change
+      expect(result.code).not.toContain('const thunk = (n, f) => {\n  while');
+      const [count, factorial, thunk] = new Function(
+        `${result.code}\nreturn [count, factorial, thunk];`
+      )();
+      expect(count(Array.from({ length: 100000 }, (_, i) => i), 0)).toBe(100000);
+      expect(factorial(5, 1)).toBe(120);
+      expect(thunk(2, () => 0)(0)).toBe(1);
+
+      // Calls below a binding that hides a parameter stay calls
+      const shadowed = compile(`
+        let fact = (n, acc) => match n {
+          0 => acc
+          n => fact(n - 1, acc * n)
+        }
+        let down = (n, acc) => match n {
+          0 => acc
+          1 => {
+            let acc = 100
+            down(0, acc)
+          }
+          _ => down(n - 1, acc + 1)
+        }
+      `);
+      expect(shadowed.success).toBe(true);
+      expect(shadowed.code).not.toContain('const fact = (n, acc) => {\n  while');
+      expect(shadowed.code).toContain('const down = (n, acc) => {\n  while (true) {');
+      const [fact, down] = new Function(`${shadowed.code}\nreturn [fact, down];`)();
+      expect(fact(5, 1)).toBe(120);
+      expect(down(5, 0)).toBe(100);
+
+      const calls = compile(source, { tailCalls: false });
+      expect(calls.code).not.toContain('while (true)');
+      const recursive = new Function(`${calls.code}\nreturn count;`)();
+      expect(recursive([1, 2, 3], 0)).toBe(3);
+    });
+
+    it('runs functions that call each other in tail position in one loop', () => {
+      const source = `
+        let isEven = (n) => if n == 0 then true else isOdd(n - 1)
+        let isOdd = (n) => if n == 0 then false else isEven(n - 1)
+        let runs = (xs, acc) => match xs {
+          [x, ...rest] => if x > 0 then inRun(rest, acc, x) else runs(rest, acc)
+          _ => acc
+        }
+        let inRun = (xs, acc, run) => match xs {
+          [x, ...rest] => if x > 0 then inRun(rest, acc, run + x) else runs(rest, acc + run)
+          _ => acc + run
+        }
+      `;
+      const result = compile(source);
+
+      expect(result.success).toBe(true);
+      expect(result.code).toContain('const __tail_isEven = (__call, __arg0) => {');
+      expect(result.code).toContain('__arg0 = (n - 1);\n          __call = 1;\n          continue;');
+      expect(result.code).toContain('const isOdd = (n) => __tail_isEven(1, n);');
+      expect(result.code).toContain('const inRun = (xs, acc, run) => __tail_runs(1, xs, acc, run);');
+      const [isEven, isOdd, runs] = new Function(`${result.code}\nreturn [isEven, isOdd, runs];`)();
+      expect(isEven(100000)).toBe(true);
+      expect(isOdd(100001)).toBe(true);
+      expect(runs([1, 2, -1, 3, 0, 4], 0)).toBe(10);
+      expect(runs(Array.from({ length: 100000 }, (_, i) => i % 3 - 1), 0)).toBe(33333);
+
+      const hidden = compile(`
+        let even = (n) => match n {
+          0 => true
+          n => odd(n - 1)
+        }
+        let odd = (n) => if n == 0 then false else even(n - 1)
+        let down = (n, acc) => match n {
+          0 => acc
+          m => up(m - 1, acc + 1)
+        }
+        let up = (n, acc) => match acc {
+          n => if n > 20 then n else down(n, acc)
+        }
+      `);
+      expect(hidden.success).toBe(true);
+      expect(hidden.code).toContain('const odd = (n) => __tail_even(1, n);');
+      const [even, down] = new Function(`${hidden.code}\nreturn [even, down];`)();
+      expect(even(100000)).toBe(true);
+      expect(down(5, 0)).toBe(21);
+
+      const mismatch = compile(`
+        let f = (n) => g(n, 1)
+        let g = (n) => f(n)
+      `);
+      expect(mismatch.success).toBe(false);
+
+      const generic = compile(`
+        let pick = (n, x) => if n == 0 then x else skip(n - 1, x)
+        let skip = (n, x) => pick(n, x)
+        let word = pick(3, "a")
+        let number = pick(3, 1)
+      `);
+      expect(generic.success).toBe(true);
+      const early = compile(`
+        let f = (x) => g(x)
+        let y = f(1)
+        let g = (x) => f(x)
+      `);
+      expect(early.errors.map(e => e.message)).toContain('Undefined variable: g');
+      const unrelated = compile(`
+        let k = (u) => id(1)
+        let id = (x) => x
+      `);
+      expect(unrelated.errors.map(e => e.message)).toContain('Undefined variable: id');
+    });
+
     it('compiles records', () => {
       const result = compile('let point = { x: 10, y: 20 }');
       
@@ -72,6 +438,103 @@ describe('Compiler', () => {
       expect(result.code).toContain('{ x: 10, y: 20 }');
     });
 
+    it('compiles functions returning records', () => {
+      const result = compile('let origin = (n) => { x: n, y: n }');
+
+      expect(result.success).toBe(true);
+      expect(new Function(`${result.code}\nreturn origin(3).y;`)()).toBe(3);
+    });
+
+    it('folds pipelines into nested direct calls', () => {
+      const result = compile(`
+        let step = (xs) => xs |> map((x) => x + 1, _) |> filter((x) => x > 2, _) |> sum(_)
+      `, { fusePipelines: false });
+
+      expect(result.success).toBe(true);
+      expect(result.code).toContain('sum(filter((x) => (x > 2), map((x) => (x + 1), xs)))');
+      expect(result.code).not.toContain('__p0');
+      const step = new Function(`${result.code}\nreturn step;`)();
+      expect(step([1, 2, 3])).toBe(7);
+    });
+
+    it('fuses combinator chains into one loop', () => {
+      const source = `
+        let step = (xs) => xs |> map((x) => x + 1, _) |> filter((x) => x > 2, _) |> sum(_)
+        let squares = (xs) => fold((acc, x) => acc + x, 10, map((x) => x * x, xs))
+        let kept = (xs) => filter((x) => x % 2 == 0, map((x) => x * 3, xs))
+      `;
+      const result = compile(source);
+
+      expect(result.success).toBe(true);
+      const program = result.code!.slice(result.code!.indexOf('const step'));
+      expect(program).not.toMatch(/\b(map|filter|fold|sum)\(/);
+      const [step, squares, kept] = new Function(`${result.code}\nreturn [step, squares, kept];`)();
+      expect(step([1, 2, 3])).toBe(7);
+      expect(squares([1, 2, 3])).toBe(24);
+      expect(kept([1, 2, 3, 4])).toEqual([6, 12]);
+
+      const shadowed = compile('let apply = (map) => sum(map((x) => x, [1]))');
+      expect(shadowed.code).toContain('sum(map(');
+      const effectful = compile('let f = (x) => do { x }\nlet g = (xs) => sum(map(f, xs))');
+      expect(effectful.code).toContain('sum(map(f, xs))');
+    });
+
+    it('hands hinted map and filter stages to the worker pool', () => {
+      const source = `
+        let k = 3
+        let scale = (xs) => xs |> @parallel(minSize: 4, chunkSize: 2) map((x) => x * k + 1, _)
+        let evens = (xs) => xs |> @parallel(minSize: 4) filter((x) => x % 2 == 0, _)
+        let nested = (xss) => xss |> @parallel(minSize: 1) map((xs) => xs |> @parallel(minSize: 1) map((x) => x + k, _), _)
+        let calls = (xs) => xs |> @parallel(minSize: 1) map((x) => scale([x]), _)
+        let rests = (xss) => xss |> @parallel(minSize: 1, chunkSize: 1) map((xs) => match xs {
+          [x, ...rest] => rest
+          _ => xs
+        }, _)
+        let shown = (xss) => rests(xss) |> @parallel(minSize: 1, chunkSize: 1) map((xs) => show(xs), _)
+      `;
+      const result = compile(source);
+
+      expect(result.success).toBe(true);
+      expect(result.code).toContain('__lw.parallel("map", (x) => ((x * k) + 1), xs, { k }, { minSize: 4, chunkSize: 2 }, { list: true, results: true })');
+      expect(result.code).toContain('__lw.parallel("filter", (x) => ((x % 2) == 0), xs, {}, { minSize: 4 }, { list: true })');
+      const [scale, evens, nested, calls, shown] = new Function(
+        `${result.code}\nreturn [scale, evens, nested, calls, shown];`
+      )();
+      const xs = Array.from({ length: 9 }, (_, i) => i);
+      expect(scale(xs)).toEqual(xs.map(x => x * 3 + 1));
+      expect(evens(xs)).toEqual([0, 2, 4, 6, 8]);
+      expect(nested([[1, 2], [3]])).toEqual([[4, 5], [6]]);
+      // Captured functions cannot be sent to a worker
+      expect(calls([1, 2])).toEqual([[4], [7]]);
+      // List views travel to and from workers as arrays
+      expect(shown([[1, 2], [3, 4, 5], [6]])).toEqual(['[2]', '[4,5]', '[]']);
+
+      const sequential = compile('let f = (xs) => xs |> seq @parallel(minSize: 1) map((x) => x, _)');
+      expect(sequential.code).not.toContain('__lw.parallel');
+      const effectful = compile('let f = (xs) => xs |> @parallel(minSize: 1) map((x) => do { x }, _)');
+      expect(effectful.code).not.toContain('__lw.parallel');
+    });
+
+    it('marks parallel stages over lists of numbers for typed array transfer', () => {
+      const source = `
+        let half = (xs) => xs |> @parallel(minSize: 1) map((x) => x * 0.5, _)
+        let label = (xs) => xs |> @parallel(minSize: 1) map((x) => if x > 5 then "big" else "small", _)
+        let lengths = (ss) => ss |> @parallel(minSize: 1) map((s) => length(s), _)
+        let same = (xs) => xs |> @parallel(minSize: 1) map((x) => x, _)
+      `;
+      const result = compile(source);
+
+      expect(result.success).toBe(true);
+      expect(result.code).toContain('__lw.parallel("map", (x) => (x * 0.5), xs, {}, { minSize: 1 }, { list: true, results: true })');
+      expect(result.code).toContain('xs, {}, { minSize: 1 }, { list: true })');
+      expect(result.code).toContain('ss, {}, { minSize: 1 }, { results: true })');
+      expect(result.code).toContain('__lw.parallel("map", (x) => x, xs, {}, { minSize: 1 })');
+      const [half, label, same] = new Function(`${result.code}\nreturn [half, label, same];`)();
+      expect(half([1, 3])).toEqual([0.5, 1.5]);
+      expect(label([1, 9])).toEqual(['small', 'big']);
+      expect(same([1, 'a'])).toEqual([1, 'a']);
+    });
+
     it('compiles partial application', () => {
       const result = compile(`
         let add = (a, b) => a + b
@@ -94,6 +557,20 @@ describe('Compiler', () => {
       expect(result.code).toContain('const math = ');
       expect(result.code).toContain('return { add, mul }');
     });
+
+    it('produces identical output with compact tokens', () => {
+      const source = `
+        let add = (a, b) => a + b
+        let describe = (n) => match n {
+          0 => "zero"
+          _ => "other"
+        }
+      `;
+      const result = compile(source, { compactTokens: true });
+
+      expect(result.success).toBe(true);
+      expect(result.code).toBe(compile(source).code);
+    });
   });
 
   describe('check', () => {
@@ -113,6 +590,82 @@ describe('Compiler', () => {
       expect(result.success).toBe(true);
       expect(result.errors.length).toBe(0);
     });
+
+    it('detects infinite types', () => {
+      const result = check('let selfApply = (f) => f(f)');
+
+      expect(result.success).toBe(false);
+      expect(result.errors[0]?.code).toBe('T006');
+    });
+
+    it('restores shadowed bindings when a scope ends', () => {
+      const { program } = parse(tokenize('let x = "outer"\nlet f = (x) => x + 1\nlet y = x').tokens);
+      const result = typeCheck(program);
+      const y = program.statements[2] as LetStatement;
+
+      expect(result.errors.length).toBe(0);
+      expect(typeToString(result.types.get(y)!)).toBe('String');
+    });
+
+    it('shares one instance per ground type', () => {
+      const { program } = parse(tokenize('let a = [{ x: 1 }]\nlet b = [{ x: 2 }]').tokens);
+      const result = typeCheck(program);
+      const [a, b] = program.statements as LetStatement[];
+
+      expect(result.errors.length).toBe(0);
+      expect(prune(result.types.get(a!.value)!)).toBe(prune(result.types.get(b!.value)!));
+    });
+
+    it('marks functions and lets as pure or effectful', () => {
+      const source = [
+        'let inc = (x) => x + 1',
+        'let logged = (x) => do { x }',
+        'let wrapped = (x) => logged(x)',
+        'let apply = (f, x) => f(x)',
+        'let bump = map(inc, _)',
+      ].join('\n');
+      const { program } = parse(tokenize(source).tokens);
+      const result = typeCheck(program);
+      const lets = program.statements as LetStatement[];
+
+      expect(result.errors.length).toBe(0);
+      expect(lets.map(stmt => result.purity.get(stmt))).toEqual(['pure', 'effectful', 'effectful', 'effectful', 'pure']);
+      expect(result.purity.get(lets[0]!.value as FunctionExpression)).toBe('pure');
+    });
+
+    it('type checks @parallel hint options as Int', () => {
+      const stage = (hint: string) => `let f = (xs) => xs |> @parallel(${hint}) map((x) => x + 1, _)`;
+
+      expect(check(stage('minSize: 1000, chunkSize: length([1, 2])')).success).toBe(true);
+      const mistyped = check(stage('minSize: "many"'));
+      expect(mistyped.errors[0]?.code).toBe('T001');
+      const unknown = check(stage('size: 10'));
+      expect(unknown.errors[0]?.message).toBe('Unknown @parallel option "size"');
+    });
+  });
+
+  describe('profiling', () => {
+    it('reports phases and counters when enabled', () => {
+      const result = compile('let add = (a, b) => a + b\nlet x = add(1, 2)', { profile: true });
+
+      expect(result.profile?.phases.map(p => p.name)).toEqual([
+        'tokenize', 'parse', 'typeCheck', 'fusePipelines', 'planParallelStages', 'planTailCalls',
+        'planSyncDoBlocks', 'emit',
+      ]);
+      expect(result.profile?.counts.tokens).toBe(22);
+      expect(result.profile?.counts.astNodes).toBeGreaterThan(0);
+      expect(result.profile?.counts.unifyCalls).toBeGreaterThan(0);
+      expect(compile('let x = 1').profile).toBeUndefined();
+    });
+
+    it('exports Chrome trace events', () => {
+      const result = compile('let x = 1', { profile: true });
+      const trace = JSON.parse(toChromeTrace(result.profile!));
+      const phases = trace.traceEvents.filter((e: { ph: string }) => e.ph === 'X');
+
+      expect(phases).toHaveLength(8);
+      expect(phases[0].name).toBe('tokenize');
+    });
   });
 
   describe('error reporting', () => {
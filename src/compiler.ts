@@ -4,10 +4,22 @@
 
 import { Source } from './source.js';
 import { CompilerError, formatError, formatErrors } from './errors.js';
-import { tokenize, LexerResult } from './lexer/index.js';
+import { tokenize, tokenizeCompact, Token, TokenStream } from './lexer/index.js';
 import { parse, ParseResult, Program } from './parser/index.js';
-import { typeCheck, TypeCheckResult } from './types/index.js';
+import { typeCheck, TypeCheckResult, analyzePurity, PurityMap } from './types/index.js';
 import { emit, EmitResult, EmitOptions } from './codegen/index.js';
+import {
+  fusePipelines,
+  planParallelStages,
+  planTailCalls,
+  planSyncDoBlocks,
+  FusionPlan,
+  ParallelPlan,
+  TailCallPlan,
+  SyncDoPlan,
+} from './optimize/index.js';
+import { CompileCache, CacheStats } from './cache/index.js';
+import { Profiler, CompileProfile, countAstNodes } from './profile.js';
 
 // ============================================================================
 // Compiler Options
@@ -18,8 +30,29 @@ export interface CompileOptions {
   filename?: string;
   /** Skip type checking */
   skipTypeCheck?: boolean;
+  /** Lex into a packed token buffer instead of per-token objects */
+  compactTokens?: boolean;
+  /** Run chains of list combinators as single loops (default: true) */
+  fusePipelines?: boolean;
+  /** Run pure map and filter stages with an `@parallel` hint on worker threads (default: true) */
+  parallelStages?: boolean;
+  /** Run functions that call themselves in tail position as loops (default: true) */
+  tailCalls?: boolean;
+  /** Run do blocks whose effects cannot return promises as plain functions (default: true) */
+  syncDoBlocks?: boolean;
+  /**
+   * Members of ambients and host globals that return plain values, as
+   * `object.member` paths (default: SYNC_EFFECTS, `console.print` and
+   * `console.log`). The host must supply synchronous implementations of
+   * them; parameters and provisions never match.
+   */
+  syncEffects?: string[];
   /** Code generation options */
   emit?: EmitOptions;
+  /** Reuse checked and emitted top-level declarations across compilations */
+  cache?: CompileCache;
+  /** Record phase timings, heap deltas and work counters */
+  profile?: boolean;
 }
 
 // ============================================================================
@@ -37,12 +70,29 @@ export interface CompileResult {
   warnings: CompilerError[];
   /** AST (for tooling) */
   ast?: Program;
+  /** Declaration hit/miss counts (if a cache was used) */
+  cache?: CacheStats;
+  /** Instrumentation (if `profile` was set) */
+  profile?: CompileProfile;
 }
 
 // ============================================================================
 // Main Compiler Function
 // ============================================================================
 
+interface LexedSource {
+  tokens: Token[] | TokenStream;
+  errors: CompilerError[];
+}
+
+function lex(source: string, options: CompileOptions): LexedSource {
+  if (options.compactTokens) {
+    const { buffer, errors } = tokenizeCompact(source);
+    return { tokens: buffer, errors };
+  }
+  return tokenize(source);
+}
+
 /**
  * Compile Lambdawg source code to JavaScript
  */
@@ -63,34 +113,102 @@ export function compile(source: string, options: CompileOptions = {}): CompileRe
     }
   };
 
+  const profiler = options.profile ? new Profiler() : null;
+  const measure = <T>(phase: string, fn: () => T): T =>
+    profiler ? profiler.measure(phase, fn) : fn();
+
   // Phase 1: Lexical Analysis
-  const lexerResult = tokenize(source);
+  const lexerResult = measure('tokenize', () => lex(source, options));
   attachSource(lexerResult.errors);
+  if (profiler) {
+    profiler.counts.tokens = lexerResult.tokens.length;
+  }
 
   if (errors.length > 0) {
-    return { success: false, errors, warnings };
+    return { success: false, errors, warnings, profile: profiler?.finish() };
   }
 
   // Phase 2: Parsing
-  const parseResult = parse(lexerResult.tokens);
+  const parseResult = measure('parse', () => parse(lexerResult.tokens));
   attachSource(parseResult.errors);
+  if (profiler) {
+    profiler.counts.astNodes = countAstNodes(parseResult.program);
+  }
 
   if (errors.length > 0) {
-    return { success: false, errors, warnings, ast: parseResult.program };
+    return { success: false, errors, warnings, ast: parseResult.program, profile: profiler?.finish() };
   }
 
   // Phase 3: Type Checking
+  const cache = options.cache;
+  const lookup = cache && measure('cacheLookup', () =>
+    cache.lookup(
+      parseResult.program,
+      JSON.stringify({
+        emit: options.emit ?? {},
+        fusePipelines: options.fusePipelines ?? true,
+        parallelStages: options.parallelStages ?? true,
+        tailCalls: options.tailCalls ?? true,
+        syncDoBlocks: options.syncDoBlocks ?? true,
+        syncEffects: options.syncEffects ?? null,
+      })
+    )
+  );
+  let typeResult: TypeCheckResult | null = null;
+
   if (!options.skipTypeCheck) {
-    const typeResult = typeCheck(parseResult.program);
+    typeResult = measure('typeCheck', () =>
+      typeCheck(parseResult.program, { checked: lookup?.checked })
+    );
     attachSource(typeResult.errors);
+    if (profiler) {
+      profiler.counts.typeVars = typeResult.stats.typeVars;
+      profiler.counts.unifyCalls = typeResult.stats.unifyCalls;
+    }
 
     if (errors.length > 0) {
-      return { success: false, errors, warnings, ast: parseResult.program };
+      return {
+        success: false,
+        errors,
+        warnings,
+        ast: parseResult.program,
+        cache: lookup?.stats,
+        profile: profiler?.finish(),
+      };
     }
   }
 
-  // Phase 4: Code Generation
-  const emitResult = emit(parseResult.program, options.emit);
+  // Phase 4: Optimization
+  const program = parseResult.program;
+  let purity: PurityMap | undefined;
+  const purityOf = () => purity ??= typeResult?.purity ?? analyzePurity(program);
+  let fusion: FusionPlan | undefined;
+  if (options.fusePipelines !== false) {
+    fusion = measure('fusePipelines', () => fusePipelines(program, purityOf()));
+  }
+  let parallel: ParallelPlan | undefined;
+  if (options.parallelStages !== false) {
+    parallel = measure('planParallelStages', () => planParallelStages(program, purityOf(), typeResult?.types));
+  }
+  let tailCalls: TailCallPlan | undefined;
+  if (options.tailCalls !== false) {
+    tailCalls = measure('planTailCalls', () => planTailCalls(program));
+  }
+  let syncDo: SyncDoPlan | undefined;
+  if (options.syncDoBlocks !== false) {
+    syncDo = measure('planSyncDoBlocks', () => planSyncDoBlocks(program, options.syncEffects));
+  }
+
+  // Phase 5: Code Generation
+  const emitResult = measure('emit', () =>
+    emit(parseResult.program, options.emit, lookup?.fragments, fusion, parallel, tailCalls, syncDo)
+  );
+
+  // Only cache declarations whose types are known
+  if (cache && lookup && typeResult) {
+    const types = typeResult;
+    measure('cacheStore', () => cache.store(lookup, types, emitResult));
+  }
 
   return {
     success: true,
@@ -98,6 +216,8 @@ export function compile(source: string, options: CompileOptions = {}): CompileRe
     errors,
     warnings,
     ast: parseResult.program,
+    cache: lookup?.stats,
+    profile: profiler?.finish(),
   };
 }
 
@@ -124,7 +244,7 @@ export function check(source: string, options: CompileOptions = {}): CompileResu
     }
   };
 
-  const lexerResult = tokenize(source);
+  const lexerResult = lex(source, options);
   attachSource(lexerResult.errors);
 
   if (errors.length > 0) {
@@ -149,6 +269,48 @@ export function check(source: string, options: CompileOptions = {}): CompileResu
   };
 }
 
+/**
+ * Type check an already-parsed program, e.g. one maintained by an
+ * IncrementalParser, without lexing and parsing the source again
+ */
+export function checkProgram(
+  source: string,
+  parsed: ParseResult & { lexerErrors?: CompilerError[] },
+  options: CompileOptions = {}
+): CompileResult {
+  const errors: CompilerError[] = [];
+  const warnings: CompilerError[] = [];
+
+  const attachSource = (errs: CompilerError[]) => {
+    for (const err of errs) {
+      err.source = source;
+      err.filename = options.filename;
+      if (err.severity === 'warning') {
+        warnings.push(err);
+      } else {
+        errors.push(err);
+      }
+    }
+  };
+
+  attachSource(parsed.lexerErrors ?? []);
+  attachSource(parsed.errors);
+
+  if (errors.length > 0) {
+    return { success: false, errors, warnings, ast: parsed.program };
+  }
+
+  const typeResult = typeCheck(parsed.program);
+  attachSource(typeResult.errors);
+
+  return {
+    success: errors.length === 0,
+    errors,
+    warnings,
+    ast: parsed.program,
+  };
+}
+
 /**
  * Format compiler errors for display
  */
@@ -167,8 +329,59 @@ export function formatCompilerError(error: CompilerError): string {
 // Low-level API (for tooling)
 // ============================================================================
 
-export { tokenize, type LexerResult } from './lexer/index.js';
-export { parse, type ParseResult } from './parser/index.js';
-export { typeCheck, type TypeCheckResult } from './types/index.js';
+export {
+  tokenize,
+  tokenizeCompact,
+  TokenBuffer,
+  type LexerResult,
+  type CompactLexerResult,
+  type TokenStream,
+} from './lexer/index.js';
+export {
+  parse,
+  IncrementalParser,
+  type ParseResult,
+  type TextEdit,
+  type IncrementalParseResult,
+} from './parser/index.js';
+export {
+  typeCheck,
+  analyzePurity,
+  type TypeCheckResult,
+  type TypeCheckOptions,
+  type Purity,
+  type PurityMap,
+} from './types/index.js';
 export { emit, type EmitResult, type EmitOptions } from './codegen/index.js';
+export {
+  fusePipelines,
+  planParallelStages,
+  planTailCalls,
+  planSyncDoBlocks,
+  SYNC_EFFECTS,
+  type FusionPlan,
+  type FusedLoop,
+  type FusedStage,
+  type FusedSink,
+  type ParallelPlan,
+  type ParallelStage,
+  type TailCallPlan,
+  type TailLoop,
+  type TailCall,
+  type TailGroup,
+  type SyncDoPlan,
+} from './optimize/index.js';
+export {
+  CompileCache,
+  MemoryCacheStorage,
+  type CacheStorage,
+  type CacheStats,
+} from './cache/index.js';
+export {
+  toChromeTrace,
+  formatProfile,
+  type CompileProfile,
+  type PhaseProfile,
+  type ProfileCounts,
+} from './profile.js';
 
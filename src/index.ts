@@ -25,6 +25,7 @@
 export {
   compile,
   check,
+  checkProgram,
   formatCompilerError,
   formatCompilerErrors,
 } from './compiler.js';
@@ -37,17 +38,53 @@ export type {
 // Low-level APIs for tooling
 export {
   tokenize,
+  tokenizeCompact,
+  TokenBuffer,
   parse,
+  IncrementalParser,
   typeCheck,
+  analyzePurity,
+  fusePipelines,
+  planParallelStages,
+  planTailCalls,
+  planSyncDoBlocks,
+  SYNC_EFFECTS,
   emit,
+  CompileCache,
+  MemoryCacheStorage,
+  toChromeTrace,
+  formatProfile,
 } from './compiler.js';
 
 export type {
   LexerResult,
+  CompactLexerResult,
+  TokenStream,
   ParseResult,
+  TextEdit,
+  IncrementalParseResult,
   TypeCheckResult,
+  TypeCheckOptions,
+  Purity,
+  PurityMap,
+  FusionPlan,
+  FusedLoop,
+  FusedStage,
+  FusedSink,
+  ParallelPlan,
+  ParallelStage,
+  TailCallPlan,
+  TailLoop,
+  TailCall,
+  TailGroup,
+  SyncDoPlan,
   EmitResult,
   EmitOptions,
+  CacheStorage,
+  CacheStats,
+  CompileProfile,
+  PhaseProfile,
+  ProfileCounts,
 } from './compiler.js';
 
 // Token types
@@ -91,6 +128,8 @@ export type {
 export {
   createPosition,
   createSpan,
+  computeLineStarts,
+  LineMap,
   formatPosition,
   getSourceLine,
 } from './source.js';
@@ -0,0 +1,167 @@
+/**
+ * Compact struct-of-arrays token storage
+ *
+ * Instead of one Token object (plus a Span and two Positions) per token, the
+ * buffer stores each token as a kind code and a start/end offset in typed
+ * arrays. Lexemes, spans and literal values are derived from the source on
+ * demand, so a token that the parser only checks the type of never allocates.
+ */
+
+import { Span, LineMap, createSpan } from '../source.js';
+import { Token, TokenType, createToken } from './tokens.js';
+
+/**
+ * Read-only, index-based view of a token sequence, consumed by the parser.
+ */
+export interface TokenStream {
+  readonly length: number;
+  typeAt(index: number): TokenType;
+  lexemeAt(index: number): string;
+  valueAt(index: number): unknown;
+  spanAt(index: number): Span;
+  tokenAt(index: number): Token;
+}
+
+const TOKEN_TYPES: TokenType[] = Object.values(TokenType);
+const TOKEN_CODES = new Map<TokenType, number>(
+  TOKEN_TYPES.map((type, code) => [type, code])
+);
+
+/**
+ * Adapts a plain Token[] (the default lexer output) to a TokenStream.
+ */
+export class TokenArray implements TokenStream {
+  private tokens: Token[];
+
+  constructor(tokens: Token[]) {
+    this.tokens = tokens;
+  }
+
+  get length(): number {
+    return this.tokens.length;
+  }
+
+  typeAt(index: number): TokenType {
+    return this.tokens[index]!.type;
+  }
+
+  lexemeAt(index: number): string {
+    return this.tokens[index]!.lexeme;
+  }
+
+  valueAt(index: number): unknown {
+    return this.tokens[index]!.value;
+  }
+
+  spanAt(index: number): Span {
+    return this.tokens[index]!.span;
+  }
+
+  tokenAt(index: number): Token {
+    return this.tokens[index]!;
+  }
+}
+
+export class TokenBuffer implements TokenStream {
+  readonly source: string;
+  private kinds: Uint8Array;
+  private starts: Uint32Array;
+  private ends: Uint32Array;
+  private values = new Map<number, unknown>();
+  private count = 0;
+  private lines: LineMap;
+
+  constructor(source: string, lines?: LineMap) {
+    this.source = source;
+    // Roughly one token per four characters of source
+    const capacity = Math.max(16, source.length >> 2);
+    this.kinds = new Uint8Array(capacity);
+    this.starts = new Uint32Array(capacity);
+    this.ends = new Uint32Array(capacity);
+    this.lines = lines ?? new LineMap(source);
+  }
+
+  get length(): number {
+    return this.count;
+  }
+
+  push(type: TokenType, start: number, end: number, value?: unknown): void {
+    if (this.count === this.kinds.length) {
+      this.grow();
+    }
+    const index = this.count++;
+    this.kinds[index] = TOKEN_CODES.get(type)!;
+    this.starts[index] = start;
+    this.ends[index] = end;
+    if (value !== undefined) {
+      this.values.set(index, value);
+    }
+  }
+
+  typeAt(index: number): TokenType {
+    return TOKEN_TYPES[this.kinds[index]!]!;
+  }
+
+  startAt(index: number): number {
+    return this.starts[index]!;
+  }
+
+  endAt(index: number): number {
+    return this.ends[index]!;
+  }
+
+  lexemeAt(index: number): string {
+    if (this.typeAt(index) === TokenType.EOF) return '';
+    return this.source.slice(this.starts[index]!, this.ends[index]!);
+  }
+
+  valueAt(index: number): unknown {
+    return this.values.get(index);
+  }
+
+  spanAt(index: number): Span {
+    return createSpan(
+      this.lines.positionAt(this.starts[index]!),
+      this.lines.positionAt(this.ends[index]!)
+    );
+  }
+
+  /**
+   * Materialize a single token as a regular Token object
+   */
+  tokenAt(index: number): Token {
+    return createToken(
+      this.typeAt(index),
+      this.lexemeAt(index),
+      this.spanAt(index),
+      this.valueAt(index)
+    );
+  }
+
+  /**
+   * Materialize every token (for tooling and tests)
+   */
+  toTokens(): Token[] {
+    const tokens: Token[] = [];
+    for (let i = 0; i < this.count; i++) {
+      tokens.push(this.tokenAt(i));
+    }
+    return tokens;
+  }
+
+  private grow(): void {
+    const capacity = this.kinds.length * 2;
+
+    const kinds = new Uint8Array(capacity);
+    kinds.set(this.kinds);
+    this.kinds = kinds;
+
+    const starts = new Uint32Array(capacity);
+    starts.set(this.starts);
+    this.starts = starts;
+
+    const ends = new Uint32Array(capacity);
+    ends.set(this.ends);
+    this.ends = ends;
+  }
+}
@@ -1,5 +1,7 @@
-export { Lexer, tokenize } from './lexer.js';
-export type { LexerResult } from './lexer.js';
+export { Lexer, tokenize, tokenizeCompact } from './lexer.js';
+export type { LexerResult, CompactLexerResult, RangeLexerResult } from './lexer.js';
+export { TokenBuffer, TokenArray } from './buffer.js';
+export type { TokenStream } from './buffer.js';
 export { 
   TokenType, 
   createToken, 
@@ -1,5 +1,5 @@
 import { describe, it, expect } from 'vitest';
-import { tokenize } from './lexer.js';
+import { tokenize, tokenizeCompact } from './lexer.js';
 import { TokenType } from './tokens.js';
 
 describe('Lexer', () => {
@@ -93,5 +93,25 @@ describe('Lexer', () => {
     expect(tokens[1]?.value).toBe(10);
     expect(tokens[2]?.value).toBe(493);
   });
-});
 
+  it('tracks line and column positions across lines', () => {
+    const { tokens } = tokenize('let a = 1\n{- x\n -} let b =\n  "two\nlines" c');
+
+    expect(tokens[4]?.span.start).toEqual({ line: 3, column: 5, offset: 19 });
+    expect(tokens[5]?.span.start).toEqual({ line: 3, column: 9, offset: 23 });
+    expect(tokens[7]?.span.start).toEqual({ line: 4, column: 3, offset: 29 });
+    expect(tokens[7]?.span.end).toEqual({ line: 5, column: 7, offset: 40 });
+    expect(tokens[8]?.span.start).toEqual({ line: 5, column: 8, offset: 41 });
+  });
+
+  it('produces the same tokens in compact mode', () => {
+    const source = 'let f = (x) => x |> map((y) => y * 2, _)\n"s\\n" 0xFF \'c\' 1.5';
+    const { tokens } = tokenize(source);
+    const { buffer } = tokenizeCompact(source);
+
+    expect(buffer.length).toBe(tokens.length);
+    expect(buffer.toTokens()).toEqual(tokens);
+    expect(buffer.typeAt(0)).toBe(TokenType.LET);
+    expect(buffer.lexemeAt(1)).toBe('f');
+  });
+});
@@ -2,46 +2,100 @@
  * Lexer for the Lambdawg language
  */
 
-import { Position, Span, createPosition, createSpan } from '../source.js';
+import { Span, LineMap, createSpan } from '../source.js';
 import { CompilerError, createError, ErrorCodes } from '../errors.js';
 import { Token, TokenType, createToken, KEYWORDS } from './tokens.js';
+import { TokenBuffer } from './buffer.js';
 
 export interface LexerResult {
   tokens: Token[];
   errors: CompilerError[];
 }
 
+export interface CompactLexerResult {
+  buffer: TokenBuffer;
+  errors: CompilerError[];
+}
+
+export interface RangeLexerResult extends LexerResult {
+  /** Offset where lexing stopped early, or null if it reached the end (and emitted EOF) */
+  stoppedAt: number | null;
+}
+
 export class Lexer {
   private source: string;
+  private lines: LineMap;
   private tokens: Token[] = [];
+  private buffer: TokenBuffer | null = null;
   private errors: CompilerError[] = [];
   
   private start = 0;
   private current = 0;
-  private line = 1;
-  private column = 1;
-  private lineStart = 0;
 
   constructor(source: string) {
     this.source = source;
+    this.lines = new LineMap(source);
   }
 
   tokenize(): LexerResult {
+    this.scanAll();
+
+    return {
+      tokens: this.tokens,
+      errors: this.errors,
+    };
+  }
+
+  /**
+   * Tokenize into a packed TokenBuffer instead of individual Token objects
+   */
+  tokenizeCompact(): CompactLexerResult {
+    this.buffer = new TokenBuffer(this.source, this.lines);
+    this.scanAll();
+
+    return {
+      buffer: this.buffer,
+      errors: this.errors,
+    };
+  }
+
+  /**
+   * Tokenize starting at `offset`, stopping before the first token boundary
+   * for which `stopAt` returns true. Used for incremental relexing: the lexer
+   * carries no state between tokens, so once it reaches a boundary that also
+   * existed in the previous source, every following token is unchanged.
+   */
+  tokenizeRange(offset: number, stopAt: (offset: number) => boolean): RangeLexerResult {
+    this.current = offset;
+    this.start = offset;
+
     while (!this.isAtEnd()) {
+      if (stopAt(this.current)) {
+        return { tokens: this.tokens, errors: this.errors, stoppedAt: this.current };
+      }
       this.start = this.current;
       this.scanToken();
     }
 
-    this.tokens.push(createToken(
-      TokenType.EOF,
-      '',
-      this.createSpan()
-    ));
+    this.tokens.push(createToken(TokenType.EOF, '', this.createSpan()));
+    return { tokens: this.tokens, errors: this.errors, stoppedAt: null };
+  }
 
-    return {
-      tokens: this.tokens,
-      errors: this.errors,
-    };
+  private scanAll(): void {
+    while (!this.isAtEnd()) {
+      this.start = this.current;
+      this.scanToken();
+    }
+
+    if (this.buffer) {
+      this.buffer.push(TokenType.EOF, this.start, this.current);
+    } else {
+      this.tokens.push(createToken(
+        TokenType.EOF,
+        '',
+        this.createSpan()
+      ));
+    }
   }
 
   private scanToken(): void {
@@ -157,11 +211,8 @@ export class Lexer {
       case ' ':
       case '\r':
       case '\t':
-        // Ignore whitespace
-        break;
-
       case '\n':
-        this.newline();
+        // Ignore whitespace (line positions come from the line map)
         break;
 
       // String literals
@@ -206,9 +257,6 @@ export class Lexer {
         this.advance();
         depth--;
       } else {
-        if (this.peek() === '\n') {
-          this.newline();
-        }
         this.advance();
       }
     }
@@ -224,14 +272,9 @@ export class Lexer {
   }
 
   private string(): void {
-    const startLine = this.line;
-    const startColumn = this.column - 1;
     let value = '';
 
     while (this.peek() !== '"' && !this.isAtEnd()) {
-      if (this.peek() === '\n') {
-        this.newline();
-      }
       if (this.peek() === '\\') {
         this.advance();
         const escaped = this.parseEscapeSequence();
@@ -417,7 +460,6 @@ export class Lexer {
   private advance(): string {
     const c = this.source[this.current]!;
     this.current++;
-    this.column++;
     return c;
   }
 
@@ -435,16 +477,9 @@ export class Lexer {
     if (this.isAtEnd()) return false;
     if (this.source[this.current] !== expected) return false;
     this.current++;
-    this.column++;
     return true;
   }
 
-  private newline(): void {
-    this.line++;
-    this.column = 1;
-    this.lineStart = this.current + 1;
-  }
-
   private isDigit(c: string): boolean {
     return c >= '0' && c <= '9';
   }
@@ -470,40 +505,19 @@ export class Lexer {
   }
 
   private createSpan(): Span {
-    const startOffset = this.start;
-    const endOffset = this.current;
-    
-    // Calculate start position
-    let startLine = 1;
-    let startCol = 1;
-    for (let i = 0; i < startOffset; i++) {
-      if (this.source[i] === '\n') {
-        startLine++;
-        startCol = 1;
-      } else {
-        startCol++;
-      }
-    }
-
-    // Calculate end position  
-    let endLine = startLine;
-    let endCol = startCol;
-    for (let i = startOffset; i < endOffset; i++) {
-      if (this.source[i] === '\n') {
-        endLine++;
-        endCol = 1;
-      } else {
-        endCol++;
-      }
-    }
-
+    // Tokens are emitted in source order, so the line map's cursor only
+    // moves forward and each lookup is amortized O(1).
     return createSpan(
-      createPosition(startLine, startCol, startOffset),
-      createPosition(endLine, endCol, endOffset)
+      this.lines.positionAt(this.start),
+      this.lines.positionAt(this.current)
     );
   }
 
   private addToken(type: TokenType, value?: unknown): void {
+    if (this.buffer) {
+      this.buffer.push(type, this.start, this.current, value);
+      return;
+    }
     const lexeme = this.source.slice(this.start, this.current);
     this.tokens.push(createToken(type, lexeme, this.createSpan(), value));
   }
@@ -522,3 +536,8 @@ export function tokenize(source: string): LexerResult {
   return lexer.tokenize();
 }
 
+export function tokenizeCompact(source: string): CompactLexerResult {
+  const lexer = new Lexer(source);
+  return lexer.tokenizeCompact();
+}
+
@@ -0,0 +1,424 @@
+/**
+ * Synchronous do block planning for Lambdawg
+ *
+ * A do block runs as an async function that awaits each `do!` effect,
+ * which costs a promise and a microtask hop even when every effect
+ * returns a plain value, as `console.print` does. This pass finds the do
+ * blocks none of whose effects can produce a promise, so that the emitter
+ * can run them as plain functions.
+ *
+ * A value may be a promise if it comes from a do block that stays async,
+ * from calling a function that may return one, or from somewhere the pass
+ * cannot see into: parameters, ambients and imported JavaScript. Members
+ * of ambients and host globals listed as synchronous are the exception,
+ * and so are the functions of records bound by `let` or `provide`, which
+ * are followed like any other. Functions that call
+ * each other are solved together, so recursion on its own does not keep
+ * a do block async.
+ */
+
+import * as ast from '../parser/ast.js';
+
+// ============================================================================
+// Sync Do Plan
+// ============================================================================
+
+/**
+ * Do blocks to emit as plain functions, and the `do!` expressions within
+ * them, which are not awaited
+ */
+export type SyncDoPlan = Set<ast.DoExpression | ast.DoEffectExpression>;
+
+/**
+ * Members of ambients and host globals assumed to return plain values, as
+ * `object.member` paths. The host must supply synchronous implementations
+ * of them. Parameters and provisions are never matched against them.
+ */
+export const SYNC_EFFECTS: readonly string[] = ['console.print', 'console.log'];
+
+/** Built-ins whose results are never promises, whatever they are given */
+const PLAIN_BUILTINS: ReadonlySet<string> = new Set([
+  'map', 'filter', 'sum', 'length', 'tail', 'show', 'Ok', 'Error', 'Some', 'None',
+]);
+
+/** Whether some value may be a promise */
+interface Fact {
+  promise: boolean;
+  /** Facts that may be promises if this one is */
+  dependents: Fact[] | null;
+}
+
+/** What a name in scope refers to */
+type Binding =
+  | { kind: 'let'; stmt: ast.LetStatement }
+  | { kind: 'module'; members: Map<string, ast.LetStatement> }
+  | { kind: 'provided'; value: ast.Expression }
+  | { kind: 'ambient' }
+  | { kind: 'opaque' };
+
+const AMBIENT: Binding = { kind: 'ambient' };
+const OPAQUE: Binding = { kind: 'opaque' };
+
+// ============================================================================
+// Effect Planner
+// ============================================================================
+
+export class EffectPlanner {
+  private syncEffects: ReadonlySet<string>;
+  private scopes = new Map<string, Binding[]>();
+  /** Result of calling each function expression */
+  private functionFacts = new Map<ast.FunctionExpression, Fact>();
+  /** Value of each let statement */
+  private valueFacts = new Map<ast.LetStatement, Fact>();
+  /** Whether each do block awaits a promise */
+  private doFacts = new Map<ast.DoExpression, Fact>();
+  /** The do block each `do!` expression belongs to */
+  private effects = new Map<ast.DoEffectExpression, Fact>();
+  /** The do block whose `do!` expressions are being visited, if any */
+  private enclosing: Fact | null = null;
+
+  constructor(syncEffects: readonly string[] = SYNC_EFFECTS) {
+    this.syncEffects = new Set(syncEffects);
+  }
+
+  plan(program: ast.Program): SyncDoPlan {
+    const bindings: [string, Binding][] = [];
+    for (const module of program.modules) {
+      const members = new Map<string, ast.LetStatement>();
+      for (const stmt of module.body) {
+        if (stmt.kind === 'LetStatement') members.set(stmt.name.name, stmt);
+      }
+      bindings.push([module.name.name, { kind: 'module', members }]);
+    }
+    declareStatements(program.statements, bindings);
+
+    this.bind(bindings);
+    for (const module of program.modules) {
+      const scope = declareStatements(module.body, []);
+      this.bind(scope);
+      for (const stmt of module.body) this.visitStatement(stmt);
+      this.unbind(scope.map(([name]) => name));
+    }
+    for (const stmt of program.statements) this.visitStatement(stmt);
+
+    this.propagate();
+
+    const plan: SyncDoPlan = new Set();
+    for (const facts of [this.doFacts, this.effects]) {
+      for (const [expr, fact] of facts) {
+        if (!fact.promise) plan.add(expr);
+      }
+    }
+    return plan;
+  }
+
+  // ===========================================================================
+  // Facts
+  // ===========================================================================
+
+  private fact<K>(facts: Map<K, Fact>, key: K): Fact {
+    let fact = facts.get(key);
+    if (fact === undefined) {
+      fact = { promise: false, dependents: null };
+      facts.set(key, fact);
+    }
+    return fact;
+  }
+
+  /** `owner` may be a promise if `fact` may */
+  private dependOn(owner: Fact, fact: Fact): void {
+    if (owner === fact) return;
+    if (fact.dependents === null) fact.dependents = [];
+    fact.dependents.push(owner);
+  }
+
+  private propagate(): void {
+    const pending: Fact[] = [];
+    for (const facts of [this.functionFacts, this.valueFacts, this.doFacts]) {
+      for (const fact of facts.values()) {
+        if (fact.promise) pending.push(fact);
+      }
+    }
+
+    while (pending.length > 0) {
+      for (const dependent of pending.pop()!.dependents ?? []) {
+        if (!dependent.promise) {
+          dependent.promise = true;
+          pending.push(dependent);
+        }
+      }
+    }
+  }
+
+  // ===========================================================================
+  // Traversal
+  // ===========================================================================
+
+  private visitStatement(stmt: ast.Statement): void {
+    if (stmt.kind === 'ExpressionStatement') {
+      this.visit(stmt.expression, null);
+    } else if (stmt.kind === 'LetStatement') {
+      const ambients = stmt.ambients?.ambients.map(a => a.name.name) ?? [];
+      this.bind(ambients.map(name => [name, AMBIENT]));
+      this.visit(stmt.value, this.fact(this.valueFacts, stmt));
+      this.unbind(ambients);
+    }
+  }
+
+  /**
+   * Visit `expr`, recording in `into` whether its value may be a promise
+   * (null when the value is not looked at)
+   */
+  private visit(expr: ast.Expression, into: Fact | null): void {
+    switch (expr.kind) {
+      case 'Literal':
+      case 'PlaceholderExpression':
+        break;
+      case 'Identifier': {
+        const binding = this.lookup(expr.name);
+        if (into === null || binding === undefined) break;
+        if (binding.kind === 'let') {
+          this.dependOn(into, this.fact(this.valueFacts, binding.stmt));
+        } else {
+          into.promise = true;
+        }
+        break;
+      }
+      case 'ListExpression':
+        for (const element of expr.elements) this.visit(element, null);
+        break;
+      case 'RecordExpression':
+        if (expr.spread) this.visit(expr.spread, null);
+        for (const field of expr.fields) this.visit(field.value, null);
+        break;
+      case 'FunctionExpression': {
+        const names: string[] = [];
+        for (const param of expr.params) ast.patternNames(param, names);
+        this.bindOpaque(names);
+        const enclosing = this.enclosing;
+        this.enclosing = null;
+        this.visit(expr.body, this.fact(this.functionFacts, expr));
+        this.enclosing = enclosing;
+        this.unbind(names);
+        break;
+      }
+      case 'CallExpression':
+        this.visit(expr.callee, null);
+        for (const arg of expr.args) this.visit(arg, null);
+        // With placeholders this is a partial application, which calls nothing yet
+        if (into !== null && !expr.args.some(arg => arg.kind === 'PlaceholderExpression')) {
+          this.call(expr.callee, into);
+        }
+        break;
+      case 'MemberExpression':
+        this.visit(expr.object, null);
+        if (into !== null) into.promise = true;
+        break;
+      case 'IndexExpression':
+        this.visit(expr.object, null);
+        this.visit(expr.index, null);
+        if (into !== null) into.promise = true;
+        break;
+      case 'UnaryExpression':
+        this.visit(expr.operand, null);
+        break;
+      case 'BinaryExpression':
+        this.visit(expr.left, null);
+        this.visit(expr.right, null);
+        break;
+      case 'PipelineExpression': {
+        if (expr.parallelHint) {
+          for (const option of Object.values(expr.parallelHint.options)) this.visit(option, null);
+        }
+        this.visit(expr.left, null);
+        this.visit(expr.right, null);
+        if (into === null) break;
+        const right = expr.right;
+        const partial = right.kind === 'CallExpression' && right.args.some(arg => arg.kind === 'PlaceholderExpression');
+        this.call(partial ? right.callee : right, into);
+        break;
+      }
+      case 'IfExpression':
+        this.visit(expr.condition, null);
+        this.visit(expr.thenBranch, into);
+        this.visit(expr.elseBranch, into);
+        break;
+      case 'MatchExpression':
+        this.visit(expr.subject, null);
+        for (const arm of expr.arms) {
+          const names = ast.patternNames(arm.pattern);
+          this.bindOpaque(names);
+          if (arm.guard) this.visit(arm.guard, null);
+          this.visit(arm.body, into);
+          this.unbind(names);
+        }
+        break;
+      case 'DoExpression': {
+        const awaits = this.fact(this.doFacts, expr);
+        const names = expr.body.flatMap(stmt => stmt.kind === 'DoLetStatement' ? ast.patternNames(stmt.pattern) : []);
+        this.bindOpaque(names);
+        const enclosing = this.enclosing;
+        this.enclosing = awaits;
+        expr.body.forEach((stmt, i) => {
+          switch (stmt.kind) {
+            case 'DoLetStatement':
+              this.visit(stmt.value, stmt.isEffect ? awaits : null);
+              break;
+            case 'DoEffectStatement':
+              this.visit(stmt.expression, awaits);
+              break;
+            case 'DoExprStatement':
+              // The last value is returned as it is, promise or not
+              this.visit(stmt.expression, i === expr.body.length - 1 ? into : null);
+              break;
+          }
+        });
+        this.enclosing = enclosing;
+        this.unbind(names);
+        if (into !== null) this.dependOn(into, awaits);
+        break;
+      }
+      case 'DoEffectExpression':
+        if (this.enclosing !== null) this.effects.set(expr, this.enclosing);
+        this.visit(expr.expression, this.enclosing);
+        break;
+      case 'SpreadExpression':
+        this.visit(expr.expression, null);
+        break;
+      case 'BlockExpression': {
+        const bindings = declareStatements(expr.statements, []);
+        this.bind(bindings);
+        for (const stmt of expr.statements) this.visitStatement(stmt);
+        if (expr.result) this.visit(expr.result, into);
+        this.unbind(bindings.map(([name]) => name));
+        break;
+      }
+      case 'ProvideExpression': {
+        for (const provision of expr.provisions) this.visit(provision.value, null);
+        const names = expr.provisions.map(p => p.name.name);
+        this.bind(expr.provisions.map(p => [p.name.name, { kind: 'provided', value: p.value }]));
+        this.visit(expr.body, into);
+        this.unbind(names);
+        break;
+      }
+    }
+  }
+
+  /**
+   * Record in `into` whether calling the value of `fn` may return a
+   * promise
+   */
+  private call(fn: ast.Expression, into: Fact): void {
+    switch (fn.kind) {
+      case 'FunctionExpression':
+        this.dependOn(into, this.fact(this.functionFacts, fn));
+        return;
+
+      case 'Identifier': {
+        const binding = this.lookup(fn.name);
+        if (binding?.kind === 'let') {
+          this.callLet(binding.stmt, into);
+        } else if (binding !== undefined || !PLAIN_BUILTINS.has(fn.name)) {
+          into.promise = true;
+        }
+        return;
+      }
+
+      case 'MemberExpression': {
+        const object = fn.object.kind === 'Identifier' ? fn.object.name : null;
+        const binding = object === null ? undefined : this.lookup(object);
+        const name = fn.property.name;
+        if (binding === undefined || binding.kind === 'ambient') {
+          if (object === null || !this.syncEffects.has(`${object}.${name}`)) into.promise = true;
+        } else if (binding.kind === 'module' && binding.members.has(name)) {
+          this.callLet(binding.members.get(name)!, into);
+        } else if (binding.kind === 'let' && !(binding.stmt.ambients && binding.stmt.ambients.ambients.length > 0)) {
+          this.callField(binding.stmt.value, name, into);
+        } else if (binding.kind === 'provided') {
+          this.callField(binding.value, name, into);
+        } else {
+          into.promise = true;
+        }
+        return;
+      }
+
+      default:
+        into.promise = true;
+    }
+  }
+
+  private callLet(stmt: ast.LetStatement, into: Fact): void {
+    if (stmt.value.kind === 'FunctionExpression' && !(stmt.ambients && stmt.ambients.ambients.length > 0)) {
+      this.dependOn(into, this.fact(this.functionFacts, stmt.value));
+    } else {
+      into.promise = true;
+    }
+  }
+
+  /**
+   * Record in `into` whether calling field `name` of `record` may return
+   * a promise
+   */
+  private callField(record: ast.Expression, name: string, into: Fact): void {
+    const field = record.kind === 'RecordExpression' && !record.spread
+      ? record.fields.find(f => f.name.name === name)?.value
+      : undefined;
+    if (field?.kind === 'FunctionExpression') {
+      this.dependOn(into, this.fact(this.functionFacts, field));
+    } else {
+      into.promise = true;
+    }
+  }
+
+  // ===========================================================================
+  // Scopes
+  // ===========================================================================
+
+  private lookup(name: string): Binding | undefined {
+    const stack = this.scopes.get(name);
+    return stack === undefined || stack.length === 0 ? undefined : stack[stack.length - 1];
+  }
+
+  private bind(bindings: [string, Binding][]): void {
+    for (const [name, binding] of bindings) {
+      let stack = this.scopes.get(name);
+      if (stack === undefined) {
+        stack = [];
+        this.scopes.set(name, stack);
+      }
+      stack.push(binding);
+    }
+  }
+
+  /** Bind `names` to unknown values */
+  private bindOpaque(names: string[]): void {
+    this.bind(names.map(name => [name, OPAQUE]));
+  }
+
+  /** Leave the scope that bound `names` */
+  private unbind(names: string[]): void {
+    for (const name of names) this.scopes.get(name)!.pop();
+  }
+}
+
+/**
+ * Add the bindings a list of statements makes in its scope
+ */
+function declareStatements(statements: ast.Statement[], bindings: [string, Binding][]): [string, Binding][] {
+  for (const stmt of statements) {
+    if (stmt.kind === 'LetStatement') {
+      bindings.push([stmt.name.name, { kind: 'let', stmt }]);
+    } else {
+      for (const name of ast.statementNames(stmt)) bindings.push([name, OPAQUE]);
+    }
+  }
+  return bindings;
+}
+
+/**
+ * Find the do blocks in a program that can run without promises, given
+ * the ambient members known to be synchronous
+ */
+export function planSyncDoBlocks(program: ast.Program, syncEffects?: readonly string[]): SyncDoPlan {
+  return new EffectPlanner(syncEffects).plan(program);
+}
@@ -0,0 +1,378 @@
+/**
+ * Pipeline fusion for Lambdawg
+ *
+ * Finds chains of the built-in list combinators, such as
+ * `xs |> map(f, _) |> filter(g, _) |> sum(_)`, whose functions are pure,
+ * so that the emitter can run each chain as a single loop instead of
+ * building every intermediate list.
+ */
+
+import * as ast from '../parser/ast.js';
+import { PURE_BUILTINS, PurityMap } from '../types/index.js';
+
+// ============================================================================
+// Fusion Plan
+// ============================================================================
+
+/** A per-element step of a fused loop */
+export type FusedStage =
+  | { kind: 'map'; fn: ast.Expression }
+  | { kind: 'filter'; fn: ast.Expression };
+
+/** What a fused loop produces from the elements that pass every stage */
+export type FusedSink =
+  | { kind: 'list' }
+  | { kind: 'sum' }
+  | { kind: 'length' }
+  | { kind: 'fold'; fn: ast.Expression; init: ast.Expression };
+
+export interface FusedLoop {
+  /** The list the chain starts from */
+  source: ast.Expression;
+  /** Stages in the order they apply to each element */
+  stages: FusedStage[];
+  sink: FusedSink;
+}
+
+/** Fused chains, keyed by the outermost call or pipeline of each */
+export type FusionPlan = Map<ast.Expression, FusedLoop>;
+
+// ============================================================================
+// Built-ins
+// ============================================================================
+
+/** Arguments of each fusable combinator, the list coming last */
+const COMBINATOR_ARITY: ReadonlyMap<string, number> = new Map([
+  ['map', 2],
+  ['filter', 2],
+  ['fold', 3],
+  ['sum', 1],
+  ['length', 1],
+]);
+
+interface ListOp {
+  name: string;
+  /** Arguments before the list */
+  args: ast.Expression[];
+  list: ast.Expression;
+}
+
+// ============================================================================
+// Pipeline Fuser
+// ============================================================================
+
+export class PipelineFuser {
+  private plan: FusionPlan = new Map();
+  private purity: PurityMap = new Map();
+  /** The let each name in scope refers to, or null for other bindings */
+  private scopes = new Map<string, (ast.LetStatement | null)[]>();
+
+  fuse(program: ast.Program, purity: PurityMap): FusionPlan {
+    this.plan = new Map();
+    this.purity = purity;
+
+    const bindings: Bindings = program.modules.map(module => [module.name.name, null]);
+    declareStatements(program.statements, bindings);
+
+    this.inScope(bindings, () => {
+      for (const module of program.modules) {
+        this.inScope(declareStatements(module.body, []), () => {
+          for (const stmt of module.body) this.visitStatement(stmt);
+        });
+      }
+      for (const stmt of program.statements) this.visitStatement(stmt);
+    });
+    return this.plan;
+  }
+
+  private visitStatement(stmt: ast.Statement): void {
+    if (stmt.kind === 'LetStatement') {
+      this.visitExpression(stmt.value);
+    } else if (stmt.kind === 'ExpressionStatement') {
+      this.visitExpression(stmt.expression);
+    }
+  }
+
+  private visitExpression(expr: ast.Expression): void {
+    if (expr.kind === 'CallExpression' || expr.kind === 'PipelineExpression') {
+      const loop = this.findChain(expr);
+      if (loop) {
+        this.plan.set(expr, loop);
+        this.visitExpression(loop.source);
+        for (const stage of loop.stages) this.visitExpression(stage.fn);
+        if (loop.sink.kind === 'fold') {
+          this.visitExpression(loop.sink.fn);
+          this.visitExpression(loop.sink.init);
+        }
+        return;
+      }
+    }
+
+    switch (expr.kind) {
+      case 'ListExpression':
+        expr.elements.forEach(e => this.visitExpression(e));
+        break;
+      case 'RecordExpression':
+        if (expr.spread) this.visitExpression(expr.spread);
+        expr.fields.forEach(field => this.visitExpression(field.value));
+        break;
+      case 'FunctionExpression':
+        this.inScope(unknown(expr.params.flatMap(p => ast.patternNames(p))), () => this.visitExpression(expr.body));
+        break;
+      case 'CallExpression':
+        this.visitExpression(expr.callee);
+        expr.args.forEach(arg => this.visitExpression(arg));
+        break;
+      case 'MemberExpression':
+        this.visitExpression(expr.object);
+        break;
+      case 'IndexExpression':
+        this.visitExpression(expr.object);
+        this.visitExpression(expr.index);
+        break;
+      case 'UnaryExpression':
+        this.visitExpression(expr.operand);
+        break;
+      case 'BinaryExpression':
+      case 'PipelineExpression':
+        this.visitExpression(expr.left);
+        this.visitExpression(expr.right);
+        break;
+      case 'IfExpression':
+        this.visitExpression(expr.condition);
+        this.visitExpression(expr.thenBranch);
+        this.visitExpression(expr.elseBranch);
+        break;
+      case 'MatchExpression':
+        this.visitExpression(expr.subject);
+        for (const arm of expr.arms) {
+          this.inScope(unknown(ast.patternNames(arm.pattern)), () => {
+            if (arm.guard) this.visitExpression(arm.guard);
+            this.visitExpression(arm.body);
+          });
+        }
+        break;
+      case 'DoExpression': {
+        const names = expr.body.flatMap(stmt => stmt.kind === 'DoLetStatement' ? ast.patternNames(stmt.pattern) : []);
+        this.inScope(unknown(names), () => {
+          for (const stmt of expr.body) this.visitExpression(stmt.kind === 'DoLetStatement' ? stmt.value : stmt.expression);
+        });
+        break;
+      }
+      case 'DoEffectExpression':
+      case 'SpreadExpression':
+        this.visitExpression(expr.expression);
+        break;
+      case 'BlockExpression':
+        this.inScope(declareStatements(expr.statements, []), () => {
+          for (const stmt of expr.statements) this.visitStatement(stmt);
+          if (expr.result) this.visitExpression(expr.result);
+        });
+        break;
+      case 'ProvideExpression':
+        for (const provision of expr.provisions) this.visitExpression(provision.value);
+        this.inScope(unknown(expr.provisions.map(p => p.name.name)), () => this.visitExpression(expr.body));
+        break;
+    }
+  }
+
+  // ===========================================================================
+  // Chains
+  // ===========================================================================
+
+  /**
+   * The fusable chain ending at `expr`: at least two combinators, one of
+   * them a map or filter, with pure functions
+   */
+  private findChain(expr: ast.Expression): FusedLoop | null {
+    const outer = this.listOp(expr);
+    if (!outer) return null;
+
+    const stages: FusedStage[] = [];
+    let sink: FusedSink;
+    switch (outer.name) {
+      case 'sum':
+      case 'length':
+        sink = { kind: outer.name };
+        break;
+      case 'fold':
+        if (!this.isPureFunction(outer.args[0]!) || !isPure(outer.args[1]!)) return null;
+        sink = { kind: 'fold', fn: outer.args[0]!, init: outer.args[1]! };
+        break;
+      default:
+        sink = { kind: 'list' };
+        if (!this.isPureFunction(outer.args[0]!)) return null;
+        stages.push({ kind: outer.name as FusedStage['kind'], fn: outer.args[0]! });
+    }
+
+    let source = outer.list;
+    for (let op = this.listOp(source); op; op = this.listOp(source)) {
+      if ((op.name !== 'map' && op.name !== 'filter') || !this.isPureFunction(op.args[0]!)) break;
+      stages.unshift({ kind: op.name, fn: op.args[0]! });
+      source = op.list;
+    }
+
+    const combinators = stages.length + (sink.kind === 'list' ? 0 : 1);
+    if (stages.length === 0 || combinators < 2) return null;
+    return { source, stages, sink };
+  }
+
+  /**
+   * A built-in combinator applied to a list, written either as a call or
+   * as a pipeline stage taking the list through `_`
+   */
+  private listOp(expr: ast.Expression): ListOp | null {
+    if (expr.kind === 'CallExpression') {
+      const name = this.combinatorName(expr.callee, expr.args.length);
+      if (name === null || expr.args.some(arg => arg.kind === 'PlaceholderExpression')) return null;
+      return { name, args: expr.args.slice(0, -1), list: expr.args[expr.args.length - 1]! };
+    }
+
+    // Parallel hints ask for a different execution strategy
+    if (expr.kind !== 'PipelineExpression' || expr.parallelHint) return null;
+    const right = expr.right;
+    if (right.kind === 'Identifier') {
+      const name = this.combinatorName(right, 1);
+      return name === null ? null : { name, args: [], list: expr.left };
+    }
+    if (right.kind === 'CallExpression') {
+      const name = this.combinatorName(right.callee, right.args.length);
+      const args = right.args.slice(0, -1);
+      if (name === null ||
+          right.args[right.args.length - 1]!.kind !== 'PlaceholderExpression' ||
+          args.some(arg => arg.kind === 'PlaceholderExpression')) {
+        return null;
+      }
+      return { name, args, list: expr.left };
+    }
+    return null;
+  }
+
+  private combinatorName(callee: ast.Expression, argCount: number): string | null {
+    if (callee.kind !== 'Identifier' || COMBINATOR_ARITY.get(callee.name) !== argCount) return null;
+    return this.isBuiltin(callee.name) ? callee.name : null;
+  }
+
+  // ===========================================================================
+  // Purity
+  // ===========================================================================
+
+  /**
+   * Whether calling `fn` can have no effect, so that the calls of
+   * several stages may be interleaved
+   */
+  private isPureFunction(fn: ast.Expression): boolean {
+    switch (fn.kind) {
+      case 'FunctionExpression':
+        return this.purity.get(fn) === 'pure';
+      case 'Identifier': {
+        const binding = this.lookup(fn.name);
+        if (binding === undefined) return PURE_BUILTINS.get(fn.name) === null;
+        return binding !== null && this.purity.get(binding) === 'pure';
+      }
+      case 'CallExpression': {
+        // Partial application of a pure function
+        if (!fn.args.some(arg => arg.kind === 'PlaceholderExpression') || !fn.args.every(isPure)) {
+          return false;
+        }
+        const called = fn.callee.kind === 'Identifier' && this.isBuiltin(fn.callee.name)
+          ? PURE_BUILTINS.get(fn.callee.name)
+          : undefined;
+        if (called === undefined) return this.isPureFunction(fn.callee);
+        const calledFn = called === null ? undefined : fn.args[called];
+        return calledFn === undefined ||
+          (calledFn.kind !== 'PlaceholderExpression' && this.isPureFunction(calledFn));
+      }
+      default:
+        return false;
+    }
+  }
+
+  // ===========================================================================
+  // Scopes
+  // ===========================================================================
+
+  private lookup(name: string): ast.LetStatement | null | undefined {
+    const stack = this.scopes.get(name);
+    return stack === undefined || stack.length === 0 ? undefined : stack[stack.length - 1];
+  }
+
+  private isBuiltin(name: string): boolean {
+    return PURE_BUILTINS.has(name) && this.lookup(name) === undefined;
+  }
+
+  private inScope(bindings: Bindings, body: () => void): void {
+    const bound: string[] = [];
+    for (const [name, binding] of bindings) {
+      let stack = this.scopes.get(name);
+      if (stack === undefined) {
+        // Any other name never bound to a let reads the same as unbound
+        if (binding === null && !PURE_BUILTINS.has(name)) continue;
+        stack = [];
+        this.scopes.set(name, stack);
+      }
+      stack.push(binding);
+      bound.push(name);
+    }
+    body();
+    // Emptied stacks stay in the map for the next scope binding the name
+    for (const name of bound) this.scopes.get(name)!.pop();
+  }
+}
+
+/** Names entering scope, each with the let it refers to if any */
+type Bindings = [string, ast.LetStatement | null][];
+
+function unknown(names: string[]): Bindings {
+  return names.map(name => [name, null]);
+}
+
+function declareStatements(statements: ast.Statement[], bindings: Bindings): Bindings {
+  for (const stmt of statements) {
+    if (stmt.kind === 'LetStatement') {
+      bindings.push([stmt.name.name, stmt]);
+    } else {
+      for (const name of ast.statementNames(stmt)) bindings.push([name, null]);
+    }
+  }
+  return bindings;
+}
+
+/**
+ * Whether evaluating `expr` certainly has no effect, judged without
+ * looking into calls
+ */
+function isPure(expr: ast.Expression): boolean {
+  switch (expr.kind) {
+    case 'Identifier':
+    case 'Literal':
+    case 'PlaceholderExpression':
+    case 'FunctionExpression':
+      return true;
+    case 'ListExpression':
+      return expr.elements.every(isPure);
+    case 'RecordExpression':
+      return (!expr.spread || isPure(expr.spread)) && expr.fields.every(field => isPure(field.value));
+    case 'SpreadExpression':
+      return isPure(expr.expression);
+    case 'MemberExpression':
+      return isPure(expr.object);
+    case 'IndexExpression':
+      return isPure(expr.object) && isPure(expr.index);
+    case 'UnaryExpression':
+      return isPure(expr.operand);
+    case 'BinaryExpression':
+      // `?` throws on an error
+      return expr.operator !== '?' && isPure(expr.left) && isPure(expr.right);
+    default:
+      return false;
+  }
+}
+
+/**
+ * Find the list combinator chains in a program that can run as single
+ * loops, given the purity of its functions
+ */
+export function fusePipelines(program: ast.Program, purity: PurityMap): FusionPlan {
+  return new PipelineFuser().fuse(program, purity);
+}
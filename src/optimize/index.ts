@@ -0,0 +1,8 @@
+export { PipelineFuser, fusePipelines } from './fusion.js';
+export type { FusionPlan, FusedLoop, FusedStage, FusedSink } from './fusion.js';
+export { ParallelPlanner, planParallelStages } from './parallel.js';
+export type { ParallelPlan, ParallelStage } from './parallel.js';
+export { TailCallPlanner, planTailCalls, stronglyConnected } from './tailcalls.js';
+export type { TailCallPlan, TailLoop, TailCall, TailGroup } from './tailcalls.js';
+export { EffectPlanner, planSyncDoBlocks, SYNC_EFFECTS } from './effects.js';
+export type { SyncDoPlan } from './effects.js';
@@ -0,0 +1,294 @@
+/**
+ * Parallel stage planning for Lambdawg
+ *
+ * Finds pipeline stages marked with a hint, such as
+ * `xs |> @parallel(minSize: 1000) map((x) => f(x), _)`, that the runtime
+ * may split across worker threads: a built-in `map` or `filter` whose
+ * function is a pure lambda reading nothing from its enclosing scopes but
+ * values that can be copied to a worker.
+ */
+
+import * as ast from '../parser/ast.js';
+import { PURE_BUILTINS, PurityMap, Type, TYPE_FLOAT, TYPE_INT, prune } from '../types/index.js';
+
+// ============================================================================
+// Parallel Plan
+// ============================================================================
+
+export interface ParallelStage {
+  kind: 'map' | 'filter';
+  fn: ast.FunctionExpression;
+  /** The list piped into the stage */
+  list: ast.Expression;
+  /** Variables the function reads from enclosing scopes, copied to workers */
+  captures: string[];
+  hint: ast.ParallelHint;
+  /**
+   * Whether the checker proved the list's elements, and for `map` the
+   * function's results, Int or Float, which workers share as typed arrays
+   */
+  numeric: { list: boolean; results: boolean };
+}
+
+/** Parallel stages, keyed by their pipeline */
+export type ParallelPlan = Map<ast.PipelineExpression, ParallelStage>;
+
+/** A lambda being checked for the variables it captures */
+interface CaptureFrame {
+  /** Scopes opened outside the lambda */
+  depth: number;
+  captures: Set<string>;
+  /** Whether it reads a name that is neither bound nor a built-in */
+  unresolved: boolean;
+}
+
+// ============================================================================
+// Parallel Planner
+// ============================================================================
+
+export class ParallelPlanner {
+  private stages: ParallelPlan = new Map();
+  private purity: PurityMap = new Map();
+  private types: Map<ast.AstNode, Type> = new Map();
+  /** The depth of the scope binding each name, innermost last */
+  private scopes = new Map<string, number[]>();
+  private depth = 0;
+  private frames: CaptureFrame[] = [];
+
+  plan(program: ast.Program, purity: PurityMap, types: Map<ast.AstNode, Type> = new Map()): ParallelPlan {
+    this.stages = new Map();
+    this.purity = purity;
+    this.types = types;
+
+    const names = program.modules.map(module => module.name.name);
+    for (const stmt of program.statements) ast.statementNames(stmt, names);
+    this.bind(names);
+    for (const module of program.modules) {
+      const members: string[] = [];
+      for (const stmt of module.body) ast.statementNames(stmt, members);
+      this.bind(members);
+      for (const stmt of module.body) this.visitStatement(stmt);
+      this.unbind(members);
+    }
+    for (const stmt of program.statements) this.visitStatement(stmt);
+    this.unbind(names);
+    return this.stages;
+  }
+
+  private visitStatement(stmt: ast.Statement): void {
+    if (stmt.kind === 'LetStatement') {
+      const ambients = stmt.ambients ? stmt.ambients.ambients.map(a => a.name.name) : [];
+      this.bind(ambients);
+      this.visit(stmt.value);
+      this.unbind(ambients);
+    } else if (stmt.kind === 'ExpressionStatement') {
+      this.visit(stmt.expression);
+    }
+  }
+
+  private visit(expr: ast.Expression): void {
+    switch (expr.kind) {
+      case 'Identifier':
+        this.read(expr.name);
+        break;
+      case 'Literal':
+      case 'PlaceholderExpression':
+        break;
+      case 'ListExpression':
+        for (const element of expr.elements) this.visit(element);
+        break;
+      case 'RecordExpression':
+        if (expr.spread) this.visit(expr.spread);
+        for (const field of expr.fields) this.visit(field.value);
+        break;
+      case 'FunctionExpression': {
+        const names: string[] = [];
+        for (const param of expr.params) ast.patternNames(param, names);
+        this.bind(names);
+        this.visit(expr.body);
+        this.unbind(names);
+        break;
+      }
+      case 'CallExpression':
+        this.visit(expr.callee);
+        for (const arg of expr.args) this.visit(arg);
+        break;
+      case 'MemberExpression':
+        this.visit(expr.object);
+        break;
+      case 'IndexExpression':
+        this.visit(expr.object);
+        this.visit(expr.index);
+        break;
+      case 'UnaryExpression':
+        this.visit(expr.operand);
+        break;
+      case 'BinaryExpression':
+        this.visit(expr.left);
+        this.visit(expr.right);
+        break;
+      case 'PipelineExpression':
+        this.visitPipeline(expr);
+        break;
+      case 'IfExpression':
+        this.visit(expr.condition);
+        this.visit(expr.thenBranch);
+        this.visit(expr.elseBranch);
+        break;
+      case 'MatchExpression':
+        this.visit(expr.subject);
+        for (const arm of expr.arms) {
+          const names = ast.patternNames(arm.pattern);
+          this.bind(names);
+          if (arm.guard) this.visit(arm.guard);
+          this.visit(arm.body);
+          this.unbind(names);
+        }
+        break;
+      case 'DoExpression': {
+        const names = expr.body.flatMap(stmt => stmt.kind === 'DoLetStatement' ? ast.patternNames(stmt.pattern) : []);
+        this.bind(names);
+        for (const stmt of expr.body) {
+          this.visit(stmt.kind === 'DoLetStatement' ? stmt.value : stmt.expression);
+        }
+        this.unbind(names);
+        break;
+      }
+      case 'DoEffectExpression':
+      case 'SpreadExpression':
+        this.visit(expr.expression);
+        break;
+      case 'BlockExpression': {
+        const names: string[] = [];
+        for (const stmt of expr.statements) ast.statementNames(stmt, names);
+        this.bind(names);
+        for (const stmt of expr.statements) this.visitStatement(stmt);
+        if (expr.result) this.visit(expr.result);
+        this.unbind(names);
+        break;
+      }
+      case 'ProvideExpression': {
+        for (const provision of expr.provisions) this.visit(provision.value);
+        const names = expr.provisions.map(p => p.name.name);
+        this.bind(names);
+        this.visit(expr.body);
+        this.unbind(names);
+        break;
+      }
+    }
+  }
+
+  // ===========================================================================
+  // Stages
+  // ===========================================================================
+
+  private visitPipeline(pipe: ast.PipelineExpression): void {
+    if (pipe.parallelHint) {
+      for (const option of Object.values(pipe.parallelHint.options)) this.visit(option);
+    }
+    this.visit(pipe.left);
+    const right = pipe.right;
+    const stage = pipe.parallelHint && !pipe.isSeq ? this.stageKind(right) : null;
+    const fn = right.kind === 'CallExpression' ? right.args[0] : undefined;
+    if (stage === null || fn?.kind !== 'FunctionExpression') {
+      this.visit(right);
+      return;
+    }
+
+    const frame: CaptureFrame = { depth: this.depth, captures: new Set(), unresolved: false };
+    this.frames.push(frame);
+    this.visit(fn);
+    this.frames.pop();
+
+    if (!frame.unresolved && this.purity.get(fn) === 'pure') {
+      const list = this.typeOf(pipe.left);
+      const fnType = this.typeOf(fn);
+      this.stages.set(pipe, {
+        kind: stage,
+        fn,
+        list: pipe.left,
+        captures: [...frame.captures],
+        hint: pipe.parallelHint!,
+        numeric: {
+          list: list?.kind === 'TypeList' && isNumber(list.elementType),
+          results: stage === 'map' && fnType?.kind === 'TypeFunc' && isNumber(fnType.returnType),
+        },
+      });
+    }
+  }
+
+  /** The type the checker inferred for an expression, if it was checked */
+  private typeOf(expr: ast.Expression): Type | undefined {
+    const type = this.types.get(expr);
+    return type && prune(type);
+  }
+
+  /** The built-in a stage such as `map((x) => ..., _)` applies to the piped list */
+  private stageKind(right: ast.Expression): ParallelStage['kind'] | null {
+    if (right.kind !== 'CallExpression' || right.callee.kind !== 'Identifier') return null;
+    const name = right.callee.name;
+    if ((name !== 'map' && name !== 'filter') || this.lookup(name) !== undefined) return null;
+    const [fn, list] = right.args;
+    return right.args.length === 2 && fn!.kind === 'FunctionExpression' &&
+      list!.kind === 'PlaceholderExpression' ? name : null;
+  }
+
+  /** Note a read of `name` by every lambda being checked */
+  private read(name: string): void {
+    if (this.frames.length === 0) return;
+    const depth = this.lookup(name);
+    for (const frame of this.frames) {
+      if (depth === undefined) {
+        // Built-ins are defined in the workers too
+        if (!PURE_BUILTINS.has(name)) frame.unresolved = true;
+      } else if (depth <= frame.depth) {
+        frame.captures.add(name);
+      }
+    }
+  }
+
+  // ===========================================================================
+  // Scopes
+  // ===========================================================================
+
+  private lookup(name: string): number | undefined {
+    const stack = this.scopes.get(name);
+    return stack === undefined || stack.length === 0 ? undefined : stack[stack.length - 1];
+  }
+
+  private bind(names: string[]): void {
+    this.depth++;
+    for (const name of names) {
+      let stack = this.scopes.get(name);
+      if (stack === undefined) {
+        stack = [];
+        this.scopes.set(name, stack);
+      }
+      stack.push(this.depth);
+    }
+  }
+
+  private unbind(names: string[]): void {
+    // Emptied stacks stay in the map for the next scope binding the name
+    for (const name of names) this.scopes.get(name)!.pop();
+    this.depth--;
+  }
+}
+
+function isNumber(type: Type): boolean {
+  const pruned = prune(type);
+  return pruned === TYPE_INT || pruned === TYPE_FLOAT;
+}
+
+/**
+ * Find the hinted pipeline stages in a program that can run on worker
+ * threads, given the purity of its functions and, if it was checked, the
+ * types of its expressions
+ */
+export function planParallelStages(
+  program: ast.Program,
+  purity: PurityMap,
+  types?: Map<ast.AstNode, Type>
+): ParallelPlan {
+  return new ParallelPlanner().plan(program, purity, types);
+}
@@ -0,0 +1,434 @@
+/**
+ * Tail call planning for Lambdawg
+ *
+ * Finds functions bound by a let that call themselves in tail position,
+ * such as
+ *
+ *   let count = (xs, n) => match xs {
+ *     [x, ...rest] => count(rest, n + 1)
+ *     _ => n
+ *   }
+ *
+ * so that the emitter can run their bodies in a loop that reassigns the
+ * parameters on each such call instead of growing the stack. Tail
+ * positions are the body itself, both branches of an `if`, match arm
+ * bodies and the results of blocks and provide expressions.
+ *
+ * Functions bound in the same statement list that call each other in
+ * tail position, such as the states of a state machine, are grouped by
+ * the strongly connected components of their tail calls. The emitter
+ * runs each group's bodies in one loop, switching to the body a call
+ * goes to.
+ */
+
+import * as ast from '../parser/ast.js';
+
+// ============================================================================
+// Tail Call Plan
+// ============================================================================
+
+/** A call in tail position of the caller itself or another in its group */
+export interface TailCall {
+  target: TailLoop;
+  /** Parameters the call passes something other than the caller's own */
+  changed: number[];
+  /**
+   * Whether an argument reads a parameter assigned before it, so that all
+   * arguments must be evaluated before any parameter is assigned
+   */
+  temps: boolean;
+}
+
+export interface TailLoop {
+  fn: ast.FunctionExpression;
+  params: string[];
+  calls: Map<ast.CallExpression, TailCall>;
+  /** Expressions in tail position that contain one of the calls */
+  paths: Set<ast.Expression>;
+  /** Group of functions calling each other, or null for one calling itself */
+  group: TailGroup | null;
+}
+
+/** Functions run in one loop, dispatched on the index of each in `members` */
+export interface TailGroup {
+  /** Name of the function running the loop */
+  name: string;
+  members: TailLoop[];
+}
+
+/** Functions to emit as loops, keyed by the let binding each */
+export type TailCallPlan = Map<ast.LetStatement, TailLoop>;
+
+// ============================================================================
+// Tail Call Planner
+// ============================================================================
+
+export class TailCallPlanner {
+  private loops: TailCallPlan = new Map();
+
+  plan(program: ast.Program): TailCallPlan {
+    this.loops = new Map();
+    for (const module of program.modules) this.visitStatements(module.body);
+    this.visitStatements(program.statements);
+    return this.loops;
+  }
+
+  private visitStatements(statements: ast.Statement[]): void {
+    this.planStatements(statements);
+    for (const stmt of statements) {
+      if (stmt.kind === 'LetStatement') this.visit(stmt.value);
+      else if (stmt.kind === 'ExpressionStatement') this.visit(stmt.expression);
+    }
+  }
+
+  /** Find the statement lists nested in an expression */
+  private visit(expr: ast.Expression): void {
+    if (expr.kind === 'BlockExpression') {
+      this.visitStatements(expr.statements);
+      if (expr.result) this.visit(expr.result);
+      return;
+    }
+    visitChildren(expr, child => this.visit(child));
+  }
+
+  /** Plan the functions bound by the lets of one statement list */
+  private planStatements(statements: ast.Statement[]): void {
+    // A call can only be followed to a name bound once in the list
+    const bound = new Map<string, number>();
+    for (const stmt of statements) {
+      for (const name of ast.statementNames(stmt)) bound.set(name, (bound.get(name) ?? 0) + 1);
+    }
+    const lets: ast.LetStatement[] = [];
+    const loops: TailLoop[] = [];
+    for (const stmt of statements) {
+      if (stmt.kind !== 'LetStatement' || bound.get(stmt.name.name) !== 1) continue;
+      const loop = candidate(stmt);
+      if (loop) {
+        lets.push(stmt);
+        loops.push(loop);
+      }
+    }
+    if (loops.length === 0) return;
+
+    // Which functions call which in tail position
+    const targets = new Map(lets.map((stmt, i) => [stmt.name.name, loops[i]!]));
+    const indices = new Map(loops.map((loop, i) => [loop, i]));
+    const edges = loops.map(loop => {
+      this.findCalls(loop.fn.body, without(targets, loop.params), loop, false);
+      return [...new Set([...loop.calls.values()].map(call => indices.get(call.target)!))];
+    });
+
+    for (const component of stronglyConnected(edges)) {
+      const members = component.map(i => loops[i]!);
+      let group: TailGroup | null = null;
+      if (members.length > 1) {
+        group = { name: `__tail_${lets[component[0]!]!.name.name}`, members };
+      } else {
+        const loop = members[0]!;
+        if (!edges[component[0]!]!.includes(component[0]!)) continue;
+        // A closure would see the parameters change under it, which the
+        // fresh bindings of each group member's parameters avoid
+        const names = new Set(loop.params);
+        if (closures(loop.fn.body).some(closure => reads(closure, names))) continue;
+      }
+
+      // Keep the calls within the component, and those a loop of its own
+      // can make by assigning its parameters
+      const inside = new Map(component.map(i => [lets[i]!.name.name, loops[i]!]));
+      for (const i of component) {
+        const loop = loops[i]!;
+        loop.calls.clear();
+        loop.paths.clear();
+        loop.group = group;
+        if (this.findCalls(loop.fn.body, without(inside, loop.params), loop, !group)) {
+          this.loops.set(lets[i]!, loop);
+        }
+      }
+    }
+  }
+
+  /**
+   * Record the calls of `targets` in tail position within `expr`,
+   * returning whether there are any. With `assigns`, the calls would
+   * assign the loop's parameters, so none below a binding hiding one
+   * is recorded; otherwise `hidden` holds the parameters hidden so far.
+   */
+  private findCalls(
+    expr: ast.Expression,
+    targets: ReadonlyMap<string, TailLoop>,
+    loop: TailLoop,
+    assigns: boolean,
+    hidden: string[] = [],
+  ): boolean {
+    let found = false;
+    switch (expr.kind) {
+      case 'CallExpression': {
+        const args = expr.args;
+        const target = expr.callee.kind === 'Identifier' ? targets.get(expr.callee.name) : undefined;
+        if (
+          target && args.length === target.params.length &&
+          args.every(arg => arg.kind !== 'PlaceholderExpression' && arg.kind !== 'SpreadExpression')
+        ) {
+          loop.calls.set(expr, tailCall(args, loop, target, hidden));
+          found = true;
+        }
+        break;
+      }
+      case 'IfExpression': {
+        const then = this.findCalls(expr.thenBranch, targets, loop, assigns, hidden);
+        found = this.findCalls(expr.elseBranch, targets, loop, assigns, hidden) || then;
+        break;
+      }
+      case 'MatchExpression':
+        for (const arm of expr.arms) {
+          const names = ast.patternNames(arm.pattern);
+          if (assigns && shadows(names, loop)) continue;
+          found = this.findCalls(arm.body, without(targets, names), loop, assigns, hide(hidden, names, loop)) || found;
+        }
+        break;
+      case 'BlockExpression': {
+        const names: string[] = [];
+        for (const stmt of expr.statements) ast.statementNames(stmt, names);
+        found = expr.result !== undefined && !(assigns && shadows(names, loop)) &&
+          this.findCalls(expr.result, without(targets, names), loop, assigns, hide(hidden, names, loop));
+        break;
+      }
+      case 'ProvideExpression': {
+        const names = expr.provisions.map(p => p.name.name);
+        found = !(assigns && shadows(names, loop)) && this.findCalls(expr.body, without(targets, names), loop, assigns, hide(hidden, names, loop));
+        break;
+      }
+    }
+    if (found) loop.paths.add(expr);
+    return found;
+  }
+}
+
+/**
+ * A function that could run as a loop: one taking plain parameters and no
+ * ambients
+ */
+function candidate(stmt: ast.LetStatement): TailLoop | null {
+  const fn = stmt.value;
+  if (fn.kind !== 'FunctionExpression' || (stmt.ambients && stmt.ambients.ambients.length > 0)) return null;
+  const params: string[] = [];
+  for (const param of fn.params) {
+    if (param.kind !== 'IdentifierPattern') return null;
+    params.push(param.name);
+  }
+  return { fn, params, calls: new Map(), paths: new Set(), group: null };
+}
+
+/**
+ * Whether `names` hide a parameter of `loop`. A loop of its own leaves the
+ * calls below them alone: it would assign the local, and an argument
+ * passing it on would not be the parameter. Groups pass arguments in
+ * variables of their own.
+ */
+function shadows(names: string[], loop: TailLoop): boolean {
+  return names.some(name => loop.params.includes(name));
+}
+
+/** `hidden` plus the parameters of `loop` that `names` hide */
+function hide(hidden: string[], names: string[], loop: TailLoop): string[] {
+  return shadows(names, loop) ? [...hidden, ...names.filter(name => loop.params.includes(name))] : hidden;
+}
+
+/** `targets` less those shadowed by `names` */
+function without(targets: ReadonlyMap<string, TailLoop>, names: string[]): ReadonlyMap<string, TailLoop> {
+  if (!names.some(name => targets.has(name))) return targets;
+  const rest = new Map(targets);
+  for (const name of names) rest.delete(name);
+  return rest;
+}
+
+/**
+ * How a tail call assigns the parameters: in order, unless an argument
+ * reads a parameter assigned before it. An argument passing a parameter
+ * on unchanged is skipped, unless a local named like it is in scope.
+ */
+function tailCall(args: ast.Expression[], loop: TailLoop, target: TailLoop, hidden: string[]): TailCall {
+  const params = loop.params;
+  const changed: number[] = [];
+  args.forEach((arg, i) => {
+    if (arg.kind !== 'Identifier' || arg.name !== params[i] || hidden.includes(arg.name)) changed.push(i);
+  });
+  // Groups pass arguments in variables of their own, leaving the
+  // parameters alone until the next body starts
+  let temps = false;
+  if (!loop.group) {
+    const assigned = new Set<string>();
+    for (const i of changed) {
+      if (reads(args[i]!, assigned)) temps = true;
+      assigned.add(params[i]!);
+    }
+  }
+  return { target, changed, temps };
+}
+
+// ============================================================================
+// Traversal
+// ============================================================================
+
+/** Call `visit` on each expression directly inside `expr` */
+function visitChildren(expr: ast.Expression, visit: (expr: ast.Expression) => void): void {
+  switch (expr.kind) {
+    case 'Identifier':
+    case 'Literal':
+    case 'PlaceholderExpression':
+      break;
+    case 'ListExpression':
+      expr.elements.forEach(visit);
+      break;
+    case 'RecordExpression':
+      if (expr.spread) visit(expr.spread);
+      for (const field of expr.fields) visit(field.value);
+      break;
+    case 'FunctionExpression':
+      visit(expr.body);
+      break;
+    case 'CallExpression':
+      visit(expr.callee);
+      expr.args.forEach(visit);
+      break;
+    case 'MemberExpression':
+      visit(expr.object);
+      break;
+    case 'IndexExpression':
+      visit(expr.object);
+      visit(expr.index);
+      break;
+    case 'UnaryExpression':
+      visit(expr.operand);
+      break;
+    case 'BinaryExpression':
+      visit(expr.left);
+      visit(expr.right);
+      break;
+    case 'PipelineExpression':
+      if (expr.parallelHint) Object.values(expr.parallelHint.options).forEach(visit);
+      visit(expr.left);
+      visit(expr.right);
+      break;
+    case 'IfExpression':
+      visit(expr.condition);
+      visit(expr.thenBranch);
+      visit(expr.elseBranch);
+      break;
+    case 'MatchExpression':
+      visit(expr.subject);
+      for (const arm of expr.arms) {
+        if (arm.guard) visit(arm.guard);
+        visit(arm.body);
+      }
+      break;
+    case 'DoExpression':
+      for (const stmt of expr.body) visit(stmt.kind === 'DoLetStatement' ? stmt.value : stmt.expression);
+      break;
+    case 'DoEffectExpression':
+    case 'SpreadExpression':
+      visit(expr.expression);
+      break;
+    case 'BlockExpression':
+      for (const stmt of expr.statements) {
+        if (stmt.kind === 'LetStatement') visit(stmt.value);
+        else if (stmt.kind === 'ExpressionStatement') visit(stmt.expression);
+      }
+      if (expr.result) visit(expr.result);
+      break;
+    case 'ProvideExpression':
+      for (const provision of expr.provisions) visit(provision.value);
+      visit(expr.body);
+      break;
+  }
+}
+
+/**
+ * Whether `expr` mentions any of `names`. Shadowing is ignored, which can
+ * only make the answer yes more often.
+ */
+function reads(expr: ast.Expression, names: ReadonlySet<string>): boolean {
+  if (expr.kind === 'Identifier') return names.has(expr.name);
+  let found = false;
+  visitChildren(expr, child => {
+    found ||= reads(child, names);
+  });
+  return found;
+}
+
+/**
+ * The outermost lambdas and do blocks within `expr`, which may run after
+ * the code around them has moved on
+ */
+function closures(expr: ast.Expression, found: ast.Expression[] = []): ast.Expression[] {
+  if (expr.kind === 'FunctionExpression' || expr.kind === 'DoExpression') {
+    found.push(expr);
+  } else {
+    visitChildren(expr, child => closures(child, found));
+  }
+  return found;
+}
+
+/**
+ * Strongly connected components of the graph with an edge from each node
+ * to the nodes in `edges[node]`, by Tarjan's algorithm. Each component is
+ * listed, in ascending order, after every component it has an edge to.
+ */
+export function stronglyConnected(edges: number[][]): number[][] {
+  const index = new Array<number>(edges.length).fill(-1);
+  const low = new Array<number>(edges.length).fill(0);
+  const onStack = new Array<boolean>(edges.length).fill(false);
+  const stack: number[] = [];
+  const components: number[][] = [];
+  let next = 0;
+
+  const enter = (node: number) => {
+    index[node] = low[node] = next++;
+    stack.push(node);
+    onStack[node] = true;
+  };
+
+  for (let root = 0; root < edges.length; root++) {
+    if (index[root] !== -1) continue;
+    // Depth-first, with the next edge to follow from each node on the path
+    const path: [number, number][] = [[root, 0]];
+    enter(root);
+    while (path.length > 0) {
+      const frame = path[path.length - 1]!;
+      const node = frame[0];
+      const to = edges[node]![frame[1]++];
+      if (to !== undefined) {
+        if (index[to] === -1) {
+          enter(to);
+          path.push([to, 0]);
+        } else if (onStack[to]) {
+          low[node] = Math.min(low[node]!, index[to]!);
+        }
+        continue;
+      }
+
+      path.pop();
+      const parent = path[path.length - 1];
+      if (parent) low[parent[0]] = Math.min(low[parent[0]]!, low[node]!);
+      if (low[node] === index[node]) {
+        const component: number[] = [];
+        let member: number;
+        do {
+          member = stack.pop()!;
+          onStack[member] = false;
+          component.push(member);
+        } while (member !== node);
+        components.push(component.sort((a, b) => a - b));
+      }
+    }
+  }
+  return components;
+}
+
+/**
+ * Find the let-bound functions in a program whose tail calls to
+ * themselves or each other can be run as a loop
+ */
+export function planTailCalls(program: ast.Program): TailCallPlan {
+  return new TailCallPlanner().plan(program);
+}
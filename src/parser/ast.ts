@@ -217,6 +217,9 @@ export interface ParallelHint extends AstNode {
   options: Record<string, Expression>;
 }
 
+/** The options a `@parallel(...)` hint accepts, each an Int */
+export const PARALLEL_HINT_OPTIONS = ['minSize', 'chunkSize'] as const;
+
 export interface IfExpression extends AstNode {
   kind: 'IfExpression';
   condition: Expression;
@@ -441,3 +444,50 @@ export function createLiteral(
   return { kind: 'Literal', type, value, span };
 }
 
+
+// ============================================================================
+// Binding Helpers
+// ============================================================================
+
+/**
+ * Names bound by a pattern, including the `rest` that a record pattern's
+ * `...` is emitted as
+ */
+export function patternNames(pattern: Pattern, names: string[] = []): string[] {
+  switch (pattern.kind) {
+    case 'IdentifierPattern':
+      names.push(pattern.name);
+      break;
+    case 'ListPattern':
+      for (const element of pattern.elements) patternNames(element, names);
+      if (pattern.rest) names.push(pattern.rest.name);
+      break;
+    case 'RecordPattern':
+      for (const field of pattern.fields) {
+        if (field.pattern) patternNames(field.pattern, names);
+        else names.push(field.name.name);
+      }
+      if (pattern.rest) names.push('rest');
+      break;
+    case 'ConstructorPattern':
+      if (pattern.fields) patternNames(pattern.fields, names);
+      break;
+    case 'RestPattern':
+      if (pattern.name) names.push(pattern.name.name);
+      break;
+  }
+  return names;
+}
+
+/**
+ * Names a statement declares in its scope: a let's name or the names an
+ * import brings in
+ */
+export function statementNames(stmt: Statement, names: string[] = []): string[] {
+  if (stmt.kind === 'LetStatement') {
+    names.push(stmt.name.name);
+  } else if (stmt.kind === 'ImportStatement' && stmt.imports) {
+    for (const item of stmt.imports.items) names.push((item.alias ?? item.name).name);
+  }
+  return names;
+}
@@ -0,0 +1,76 @@
+import { describe, it, expect } from 'vitest';
+import { tokenize } from '../lexer/lexer.js';
+import { parse } from './parser.js';
+import { IncrementalParser, TextEdit } from './incremental.js';
+
+const SOURCE = `let a = 1
+let b = (x) => x + a
+module math {
+  let add = (x, y) => x + y
+}
+type Color = | Red | Green
+let c = match b(2) {
+  3 => "three"
+  _ => "other"
+}
+let d = [1, 2, 3]
+`;
+
+function applyEdit(source: string, edit: TextEdit): string {
+  return source.slice(0, edit.start) + edit.text + source.slice(edit.end);
+}
+
+function fullParse(source: string) {
+  const { tokens } = tokenize(source);
+  return parse(tokens);
+}
+
+describe('IncrementalParser', () => {
+  it('matches a full parse after an edit', () => {
+    const parser = new IncrementalParser(SOURCE);
+    const start = SOURCE.indexOf('x + a');
+    const edit = { start, end: start + 1, text: 'first(x)' };
+
+    const result = parser.edit(edit);
+    const expected = fullParse(applyEdit(SOURCE, edit));
+
+    expect(result.program).toEqual(expected.program);
+    expect(result.errors).toEqual(expected.errors);
+  });
+
+  it('reuses unchanged top-level nodes by identity', () => {
+    const parser = new IncrementalParser(SOURCE);
+    const before = parser.result.program;
+    const start = SOURCE.indexOf('"three"');
+
+    const result = parser.edit({ start, end: start + 7, text: '"3"' });
+
+    expect(result.program.statements[0]).toBe(before.statements[0]);
+    expect(result.program.modules[0]).toBe(before.modules[0]);
+    expect(result.program.statements[4]).toBe(before.statements[4]);
+    expect(result.program.statements[3]).not.toBe(before.statements[3]);
+    expect(result.stats.reparsedItems).toBeLessThan(3);
+  });
+
+  it('shifts positions of reused nodes', () => {
+    const parser = new IncrementalParser(SOURCE);
+    const result = parser.edit({ start: 0, end: 0, text: '-- header\n\n' });
+    const last = result.program.statements[result.program.statements.length - 1]!;
+
+    expect(last.span.start).toEqual({ line: 13, column: 1, offset: SOURCE.indexOf('let d') + 11 });
+    expect(result.program).toEqual(fullParse(parser.source).program);
+  });
+
+  it('recovers when an edit changes statement boundaries', () => {
+    const parser = new IncrementalParser(SOURCE);
+    const start = SOURCE.indexOf('}\ntype');
+
+    // Removing the module's closing brace swallows the following statements
+    const removed = parser.edit({ start, end: start + 1, text: '' });
+    expect(removed.errors).toEqual(fullParse(parser.source).errors);
+
+    const restored = parser.edit({ start, end: start, text: '}' });
+    expect(restored.errors.length).toBe(0);
+    expect(restored.program).toEqual(fullParse(SOURCE).program);
+  });
+});
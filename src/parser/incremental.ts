@@ -0,0 +1,322 @@
+/**
+ * Incremental lexing and parsing for editor integrations
+ *
+ * The token stream is split into chunks, one per top-level module or
+ * statement. On an edit, only the damaged chunks are relexed and reparsed;
+ * everything before them is kept as is, and everything after them is reused
+ * by identity with its source positions shifted in place.
+ *
+ * Note that reused tokens and AST nodes are mutated: after edit(), results
+ * returned by earlier calls share nodes with the new tree.
+ */
+
+import { Position, mergeSpans } from '../source.js';
+import { CompilerError } from '../errors.js';
+import { Lexer } from '../lexer/lexer.js';
+import { Token, TokenType } from '../lexer/tokens.js';
+import { Parser, ParseResult } from './parser.js';
+import * as ast from './ast.js';
+
+export interface TextEdit {
+  /** Offset of the first replaced character in the previous source */
+  start: number;
+  /** Offset one past the last replaced character in the previous source */
+  end: number;
+  /** Replacement text */
+  text: string;
+}
+
+export interface IncrementalStats {
+  /** Tokens produced by the lexer for this update */
+  relexedTokens: number;
+  /** Top-level items parsed for this update */
+  reparsedItems: number;
+  /** Top-level items reused from the previous tree */
+  reusedItems: number;
+}
+
+export interface IncrementalParseResult extends ParseResult {
+  lexerErrors: CompilerError[];
+  tokens: Token[];
+  stats: IncrementalStats;
+}
+
+interface Chunk {
+  /** Index of the chunk's first token */
+  start: number;
+  /** Index one past the chunk's last token */
+  end: number;
+  item: ast.Module | ast.Statement | null;
+  errors: CompilerError[];
+}
+
+export class IncrementalParser {
+  private text = '';
+  private tokens: Token[] = [];
+  private lexerErrors: CompilerError[] = [];
+  private chunks: Chunk[] = [];
+  private program!: ast.Program;
+  private stats: IncrementalStats = { relexedTokens: 0, reparsedItems: 0, reusedItems: 0 };
+
+  constructor(source: string) {
+    this.reset(source);
+  }
+
+  get source(): string {
+    return this.text;
+  }
+
+  get result(): IncrementalParseResult {
+    const errors: CompilerError[] = [];
+    for (const chunk of this.chunks) {
+      errors.push(...chunk.errors);
+    }
+
+    return {
+      program: this.program,
+      errors,
+      lexerErrors: this.lexerErrors,
+      tokens: this.tokens,
+      stats: this.stats,
+    };
+  }
+
+  /**
+   * Discard all state and parse `source` from scratch
+   */
+  reset(source: string): IncrementalParseResult {
+    const lexed = new Lexer(source).tokenize();
+    this.text = source;
+    this.tokens = lexed.tokens;
+    this.lexerErrors = lexed.errors;
+    this.chunks = this.parseChunks(this.tokens, 0, () => false).chunks;
+    this.program = this.buildProgram();
+    this.stats = {
+      relexedTokens: this.tokens.length,
+      reparsedItems: this.chunks.length,
+      reusedItems: 0,
+    };
+    return this.result;
+  }
+
+  /**
+   * Apply a text edit and update the token stream and AST
+   */
+  edit(edit: TextEdit): IncrementalParseResult {
+    const oldSource = this.text;
+    const oldTokens = this.tokens;
+    const oldChunks = this.chunks;
+
+    if (edit.start < 0 || edit.end < edit.start || edit.end > oldSource.length) {
+      throw new RangeError(`Invalid edit range: ${edit.start}..${edit.end}`);
+    }
+
+    const source = oldSource.slice(0, edit.start) + edit.text + oldSource.slice(edit.end);
+    const delta = edit.text.length - (edit.end - edit.start);
+
+    if (oldChunks.length === 0) {
+      return this.reset(source);
+    }
+
+    // Restart one chunk before the one containing the edit: the previous
+    // chunk's extent depends on the first token of the damaged one.
+    const first = Math.max(0, this.chunkBefore(edit.start) - 1);
+    const restartToken = first === 0 ? 0 : oldChunks[first]!.start;
+    const restartOffset = first === 0 ? 0 : this.chunkOffset(first);
+
+    // Relex until reaching the start of an old chunk lying wholly after the
+    // edit; tokens from there on are the old ones, shifted by `delta`.
+    const resumeChunkAt = (offset: number): number => {
+      const oldOffset = offset - delta;
+      if (oldOffset < edit.end) return -1;
+      const index = this.chunkBefore(oldOffset + 1);
+      return index > first && this.chunkOffset(index) === oldOffset ? index : -1;
+    };
+
+    const lexed = new Lexer(source).tokenizeRange(restartOffset, offset => resumeChunkAt(offset) !== -1);
+    const resumeChunk = lexed.stoppedAt === null ? oldChunks.length : resumeChunkAt(lexed.stoppedAt);
+    const oldSuffixStart = resumeChunk < oldChunks.length ? oldChunks[resumeChunk]!.start : oldTokens.length;
+    const suffixTokens = oldTokens.slice(oldSuffixStart);
+    const suffixOffset = resumeChunk < oldChunks.length
+      ? oldTokens[oldSuffixStart]!.span.start.offset
+      : Infinity;
+
+    const shift = this.createShift(oldSource, source, edit);
+    for (const token of suffixTokens) {
+      shift(token.span.start);
+      shift(token.span.end);
+    }
+
+    const lexerErrors: CompilerError[] = [];
+    for (const error of this.lexerErrors) {
+      if (error.span.start.offset < restartOffset) {
+        lexerErrors.push(error);
+      }
+    }
+    lexerErrors.push(...lexed.errors);
+    for (const error of this.lexerErrors) {
+      if (error.span.start.offset >= suffixOffset) {
+        shift(error.span.start);
+        shift(error.span.end);
+        lexerErrors.push(error);
+      }
+    }
+
+    const tokens = oldTokens.slice(0, restartToken).concat(lexed.tokens, suffixTokens);
+    const suffixStart = restartToken + lexed.tokens.length;
+    const indexShift = suffixStart - oldSuffixStart;
+
+    // Reparse until the parser lands on the start of a reusable old chunk
+    const reparsed = this.parseChunks(tokens, restartToken, index => {
+      if (index < suffixStart) return false;
+      return this.findChunkStartingAt(index - indexShift, resumeChunk) !== -1;
+    });
+
+    const reuseFrom = reparsed.stoppedAt === null
+      ? oldChunks.length
+      : this.findChunkStartingAt(reparsed.stoppedAt - indexShift, resumeChunk);
+    const reused = oldChunks.slice(reuseFrom);
+    for (const chunk of reused) {
+      chunk.start += indexShift;
+      chunk.end += indexShift;
+    }
+
+    this.text = source;
+    this.tokens = tokens;
+    this.lexerErrors = lexerErrors;
+    this.chunks = oldChunks.slice(0, first).concat(reparsed.chunks, reused);
+    this.program = this.buildProgram();
+    this.stats = {
+      relexedTokens: lexed.tokens.length,
+      reparsedItems: reparsed.chunks.length,
+      reusedItems: first + reused.length,
+    };
+    return this.result;
+  }
+
+  /**
+   * Parse top-level items from token `start` until EOF, or until `stopAt`
+   * accepts the index of the next item.
+   */
+  private parseChunks(
+    tokens: Token[],
+    start: number,
+    stopAt: (index: number) => boolean
+  ): { chunks: Chunk[]; stoppedAt: number | null } {
+    const parser = new Parser(tokens);
+    const chunks: Chunk[] = [];
+    let index = start;
+
+    while (tokens[index]!.type !== TokenType.EOF) {
+      if (stopAt(index)) {
+        return { chunks, stoppedAt: index };
+      }
+      const parsed = parser.parseTopLevelAt(index);
+      chunks.push({ start: index, end: parsed.end, item: parsed.item, errors: parsed.errors });
+      index = parsed.end;
+    }
+
+    return { chunks, stoppedAt: null };
+  }
+
+  private buildProgram(): ast.Program {
+    const modules: ast.Module[] = [];
+    const statements: ast.Statement[] = [];
+
+    for (const chunk of this.chunks) {
+      if (chunk.item?.kind === 'Module') {
+        modules.push(chunk.item);
+      } else if (chunk.item) {
+        statements.push(chunk.item);
+      }
+    }
+
+    // Same span as Parser.parse() computes for the whole program
+    const span = statements.length > 0 || modules.length > 0
+      ? mergeSpans(
+          (modules[0] ?? statements[0])!.span,
+          (statements[statements.length - 1] ?? modules[modules.length - 1])!.span
+        )
+      : this.tokens[this.tokens.length - 1]!.span;
+
+    return ast.createProgram(modules, statements, span);
+  }
+
+  private chunkOffset(index: number): number {
+    return this.tokens[this.chunks[index]!.start]!.span.start.offset;
+  }
+
+  /**
+   * Index of the last chunk starting before `offset` (0 if none)
+   */
+  private chunkBefore(offset: number): number {
+    let lo = 0;
+    let hi = this.chunks.length - 1;
+    while (lo < hi) {
+      const mid = (lo + hi + 1) >>> 1;
+      if (this.chunkOffset(mid) < offset) {
+        lo = mid;
+      } else {
+        hi = mid - 1;
+      }
+    }
+    return lo;
+  }
+
+  /**
+   * Index of the old chunk (at or after `from`) whose first token is `tokenIndex`
+   */
+  private findChunkStartingAt(tokenIndex: number, from: number): number {
+    let lo = from;
+    let hi = this.chunks.length - 1;
+    while (lo <= hi) {
+      const mid = (lo + hi) >>> 1;
+      const start = this.chunks[mid]!.start;
+      if (start === tokenIndex) return mid;
+      if (start < tokenIndex) {
+        lo = mid + 1;
+      } else {
+        hi = mid - 1;
+      }
+    }
+    return -1;
+  }
+
+  /**
+   * Build a function that moves a position from after the edit in the old
+   * source to the corresponding position in the new source
+   */
+  private createShift(oldSource: string, source: string, edit: TextEdit): (pos: Position) => void {
+    const delta = edit.text.length - (edit.end - edit.start);
+    const lineDelta = countNewlines(edit.text) - countNewlines(oldSource.slice(edit.start, edit.end));
+    const columnDelta =
+      columnAt(source, edit.start + edit.text.length) - columnAt(oldSource, edit.end);
+
+    // Positions on the same line as the end of the edit also move sideways
+    const lineEnd = oldSource.indexOf('\n', edit.end);
+    const sameLineLimit = lineEnd === -1 ? Infinity : lineEnd;
+
+    return (pos: Position) => {
+      if (pos.offset <= sameLineLimit) {
+        pos.column += columnDelta;
+      }
+      pos.line += lineDelta;
+      pos.offset += delta;
+    };
+  }
+}
+
+function countNewlines(text: string): number {
+  let count = 0;
+  let i = text.indexOf('\n');
+  while (i !== -1) {
+    count++;
+    i = text.indexOf('\n', i + 1);
+  }
+  return count;
+}
+
+function columnAt(source: string, offset: number): number {
+  if (offset === 0) return 1;
+  return offset - (source.lastIndexOf('\n', offset - 1) + 1) + 1;
+}
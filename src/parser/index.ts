@@ -1,3 +1,5 @@
 export { Parser, parse, type ParseResult } from './parser.js';
 export * from './ast.js';
 
+export { IncrementalParser } from './incremental.js';
+export type { TextEdit, IncrementalStats, IncrementalParseResult } from './incremental.js';
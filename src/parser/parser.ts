@@ -7,6 +7,7 @@
 import { Span, createSpan, mergeSpans } from '../source.js';
 import { CompilerError, createError, ErrorCodes } from '../errors.js';
 import { Token, TokenType } from '../lexer/tokens.js';
+import { TokenStream, TokenArray } from '../lexer/buffer.js';
 import * as ast from './ast.js';
 
 export interface ParseResult {
@@ -14,13 +15,21 @@ export interface ParseResult {
   errors: CompilerError[];
 }
 
+export interface TopLevelParseResult {
+  /** The parsed item, or null if error recovery discarded it */
+  item: ast.Module | ast.Statement | null;
+  /** Index of the first token after the item */
+  end: number;
+  errors: CompilerError[];
+}
+
 export class Parser {
-  private tokens: Token[];
+  private tokens: TokenStream;
   private current = 0;
   private errors: CompilerError[] = [];
 
-  constructor(tokens: Token[]) {
-    this.tokens = tokens;
+  constructor(tokens: Token[] | TokenStream) {
+    this.tokens = Array.isArray(tokens) ? new TokenArray(tokens) : tokens;
   }
 
   parse(): ParseResult {
@@ -28,15 +37,11 @@ export class Parser {
     const modules: ast.Module[] = [];
 
     while (!this.isAtEnd()) {
-      try {
-        if (this.check(TokenType.MODULE)) {
-          modules.push(this.parseModule());
-        } else {
-          const stmt = this.parseStatement();
-          if (stmt) statements.push(stmt);
-        }
-      } catch (e) {
-        this.synchronize();
+      const item = this.parseTopLevel();
+      if (item?.kind === 'Module') {
+        modules.push(item);
+      } else if (item) {
+        statements.push(item);
       }
     }
 
@@ -45,7 +50,7 @@ export class Parser {
           (modules[0] ?? statements[0])!.span,
           (statements[statements.length - 1] ?? modules[modules.length - 1])!.span
         )
-      : this.peek().span;
+      : this.peekSpan();
 
     return {
       program: ast.createProgram(modules, statements, span),
@@ -53,12 +58,36 @@ export class Parser {
     };
   }
 
+  /**
+   * Parse the single top-level module or statement starting at token `index`.
+   * Parsing an item only depends on the tokens from its start onwards, which
+   * lets incremental reparsing restart at any top-level boundary.
+   */
+  parseTopLevelAt(index: number): TopLevelParseResult {
+    this.current = index;
+    this.errors = [];
+    const item = this.parseTopLevel();
+    return { item, end: this.current, errors: this.errors };
+  }
+
+  private parseTopLevel(): ast.Module | ast.Statement | null {
+    try {
+      if (this.check(TokenType.MODULE)) {
+        return this.parseModule();
+      }
+      return this.parseStatement();
+    } catch (e) {
+      this.synchronize();
+      return null;
+    }
+  }
+
   // ===========================================================================
   // Module Parsing
   // ===========================================================================
 
   private parseModule(): ast.Module {
-    const start = this.consume(TokenType.MODULE, 'Expected "module"');
+    const start = this.consumeSpan(TokenType.MODULE, 'Expected "module"');
     const name = this.parseIdentifier();
     
     let providing: ast.ProvisionList | undefined;
@@ -66,7 +95,7 @@ export class Parser {
       providing = this.parseProvisionList();
     }
 
-    this.consume(TokenType.LBRACE, 'Expected "{" after module name');
+    this.expect(TokenType.LBRACE, 'Expected "{" after module name');
     
     const body: ast.Statement[] = [];
     while (!this.check(TokenType.RBRACE) && !this.isAtEnd()) {
@@ -74,20 +103,20 @@ export class Parser {
       if (stmt) body.push(stmt);
     }
 
-    const end = this.consume(TokenType.RBRACE, 'Expected "}" to close module');
+    const end = this.consumeSpan(TokenType.RBRACE, 'Expected "}" to close module');
 
     return {
       kind: 'Module',
       name,
       providing,
       body,
-      span: mergeSpans(start.span, end.span),
+      span: mergeSpans(start, end),
     };
   }
 
   private parseProvisionList(): ast.ProvisionList {
     const provisions: ast.Provision[] = [];
-    const start = this.previous().span;
+    const start = this.previousSpan();
 
     do {
       provisions.push(this.parseProvision());
@@ -96,13 +125,13 @@ export class Parser {
     return {
       kind: 'ProvisionList',
       provisions,
-      span: mergeSpans(start, this.previous().span),
+      span: mergeSpans(start, this.previousSpan()),
     };
   }
 
   private parseProvision(): ast.Provision {
     const name = this.parseIdentifier();
-    this.consume(TokenType.EQ, 'Expected "=" in provision');
+    this.expect(TokenType.EQ, 'Expected "=" in provision');
     const value = this.parseExpression();
 
     return {
@@ -139,7 +168,7 @@ export class Parser {
 
   private parseLetStatement(): ast.LetStatement {
     const isPrivate = this.match(TokenType.PRIVATE);
-    const start = this.consume(TokenType.LET, 'Expected "let"');
+    const start = this.consumeSpan(TokenType.LET, 'Expected "let"');
     const name = this.parseIdentifier();
 
     let ambients: ast.AmbientList | undefined;
@@ -152,7 +181,7 @@ export class Parser {
       typeAnnotation = this.parseTypeExpression();
     }
 
-    this.consume(TokenType.EQ, 'Expected "=" after let binding name');
+    this.expect(TokenType.EQ, 'Expected "=" after let binding name');
     const value = this.parseExpression();
 
     return {
@@ -162,13 +191,13 @@ export class Parser {
       typeAnnotation,
       ambients,
       value,
-      span: mergeSpans(start.span, value.span),
+      span: mergeSpans(start, value.span),
     };
   }
 
   private parseAmbientList(): ast.AmbientList {
     const ambients: ast.AmbientDecl[] = [];
-    const start = this.previous().span;
+    const start = this.previousSpan();
 
     do {
       ambients.push(this.parseAmbientDecl());
@@ -177,7 +206,7 @@ export class Parser {
     return {
       kind: 'AmbientList',
       ambients,
-      span: mergeSpans(start, this.previous().span),
+      span: mergeSpans(start, this.previousSpan()),
     };
   }
 
@@ -198,7 +227,7 @@ export class Parser {
   }
 
   private parseTypeDefinition(): ast.TypeDefinition {
-    const start = this.consume(TokenType.TYPE, 'Expected "type"');
+    const start = this.consumeSpan(TokenType.TYPE, 'Expected "type"');
     const name = this.parseTypeIdentifier();
 
     const typeParams: ast.Identifier[] = [];
@@ -206,7 +235,7 @@ export class Parser {
       typeParams.push(this.parseIdentifier());
     }
 
-    this.consume(TokenType.EQ, 'Expected "=" after type name');
+    this.expect(TokenType.EQ, 'Expected "=" after type name');
     const body = this.parseTypeBody();
 
     return {
@@ -214,7 +243,7 @@ export class Parser {
       name: { kind: 'Identifier', name: name.name, span: name.span },
       typeParams,
       body,
-      span: mergeSpans(start.span, body.span),
+      span: mergeSpans(start, body.span),
     };
   }
 
@@ -233,7 +262,7 @@ export class Parser {
 
   private parseSumType(): ast.SumType {
     const variants: ast.Variant[] = [];
-    const start = this.peek().span;
+    const start = this.peekSpan();
 
     // Optional leading pipe
     this.match(TokenType.PIPE);
@@ -245,7 +274,7 @@ export class Parser {
     return {
       kind: 'SumType',
       variants,
-      span: mergeSpans(start, this.previous().span),
+      span: mergeSpans(start, this.previousSpan()),
     };
   }
 
@@ -255,26 +284,26 @@ export class Parser {
 
     if (this.match(TokenType.LBRACE)) {
       fields = this.parseRecordTypeFields();
-      this.consume(TokenType.RBRACE, 'Expected "}" after variant fields');
+      this.expect(TokenType.RBRACE, 'Expected "}" after variant fields');
     }
 
     return {
       kind: 'Variant',
       name: { kind: 'Identifier', name: name.name, span: name.span },
       fields,
-      span: fields ? mergeSpans(name.span, this.previous().span) : name.span,
+      span: fields ? mergeSpans(name.span, this.previousSpan()) : name.span,
     };
   }
 
   private parseImportStatement(): ast.ImportStatement {
-    const start = this.consume(TokenType.IMPORT, 'Expected "import"');
+    const start = this.consumeSpan(TokenType.IMPORT, 'Expected "import"');
     const isJs = this.match(TokenType.JS);
     const moduleName = this.parseIdentifier();
 
     let imports: ast.ImportList | undefined;
     if (this.match(TokenType.LBRACE)) {
       imports = this.parseImportList();
-      this.consume(TokenType.RBRACE, 'Expected "}" after import list');
+      this.expect(TokenType.RBRACE, 'Expected "}" after import list');
     }
 
     return {
@@ -282,13 +311,13 @@ export class Parser {
       isJs,
       moduleName,
       imports,
-      span: mergeSpans(start.span, this.previous().span),
+      span: mergeSpans(start, this.previousSpan()),
     };
   }
 
   private parseImportList(): ast.ImportList {
     const items: ast.ImportItem[] = [];
-    const start = this.previous().span;
+    const start = this.previousSpan();
     let isWildcard = false;
 
     if (this.match(TokenType.STAR)) {
@@ -303,7 +332,7 @@ export class Parser {
       kind: 'ImportList',
       items,
       isWildcard,
-      span: mergeSpans(start, this.previous().span),
+      span: mergeSpans(start, this.previousSpan()),
     };
   }
 
@@ -342,9 +371,9 @@ export class Parser {
   }
 
   private parsePrefixExpression(): ast.Expression {
-    const token = this.peek();
+    const type = this.peekType();
 
-    switch (token.type) {
+    switch (type) {
       case TokenType.INT:
       case TokenType.FLOAT:
       case TokenType.STRING:
@@ -390,17 +419,17 @@ export class Parser {
       case TokenType.DOTDOTDOT:
         return this.parseSpread();
 
-      default:
-        this.error(ErrorCodes.EXPECTED_EXPRESSION, `Expected expression, got ${token.type}`);
-        this.advance();
-        return ast.createIdentifier('_error_', token.span);
+      default: {
+        const span = this.peekSpan();
+        this.error(ErrorCodes.EXPECTED_EXPRESSION, `Expected expression, got ${type}`);
+        this.skip();
+        return ast.createIdentifier('_error_', span);
+      }
     }
   }
 
   private parseInfixExpression(left: ast.Expression): ast.Expression {
-    const token = this.peek();
-
-    switch (token.type) {
+    switch (this.peekType()) {
       case TokenType.PLUS:
       case TokenType.MINUS:
       case TokenType.STAR:
@@ -437,9 +466,7 @@ export class Parser {
   }
 
   private getInfixPrecedence(): Precedence {
-    const token = this.peek();
-
-    switch (token.type) {
+    switch (this.peekType()) {
       case TokenType.OR:
         return Precedence.OR;
       case TokenType.AND:
@@ -475,39 +502,41 @@ export class Parser {
   // Individual expression parsers
 
   private parseLiteral(): ast.Literal {
-    const token = this.advance();
+    const type = this.peekType();
+    const span = this.advanceSpan();
+    const value = this.previousValue();
 
-    switch (token.type) {
+    switch (type) {
       case TokenType.INT:
-        return ast.createLiteral('int', token.value as number, token.span);
+        return ast.createLiteral('int', value as number, span);
       case TokenType.FLOAT:
-        return ast.createLiteral('float', token.value as number, token.span);
+        return ast.createLiteral('float', value as number, span);
       case TokenType.STRING:
-        return ast.createLiteral('string', token.value as string, token.span);
+        return ast.createLiteral('string', value as string, span);
       case TokenType.CHAR:
-        return ast.createLiteral('char', token.value as string, token.span);
+        return ast.createLiteral('char', value as string, span);
       case TokenType.TRUE:
-        return ast.createLiteral('bool', true, token.span);
+        return ast.createLiteral('bool', true, span);
       case TokenType.FALSE:
-        return ast.createLiteral('bool', false, token.span);
+        return ast.createLiteral('bool', false, span);
       default:
-        throw new Error(`Unexpected literal type: ${token.type}`);
+        throw new Error(`Unexpected literal type: ${type}`);
     }
   }
 
   private parseIdentifier(): ast.Identifier {
-    const token = this.consume(TokenType.IDENT, 'Expected identifier');
-    return ast.createIdentifier(token.lexeme, token.span);
+    const span = this.consumeSpan(TokenType.IDENT, 'Expected identifier');
+    return ast.createIdentifier(this.previousLexeme(), span);
   }
 
   private parseTypeIdentifier(): ast.TypeIdentifier {
-    const token = this.consume(TokenType.TYPE_IDENT, 'Expected type identifier');
-    return { kind: 'TypeIdentifier', name: token.lexeme, span: token.span };
+    const span = this.consumeSpan(TokenType.TYPE_IDENT, 'Expected type identifier');
+    return { kind: 'TypeIdentifier', name: this.previousLexeme(), span };
   }
 
   private parseConstructorOrIdentifier(): ast.Expression {
-    const token = this.advance();
-    const name = ast.createIdentifier(token.lexeme, token.span);
+    const span = this.advanceSpan();
+    const name = ast.createIdentifier(this.previousLexeme(), span);
 
     // Check if it's a constructor call with fields
     if (this.check(TokenType.LBRACE)) {
@@ -524,11 +553,20 @@ export class Parser {
   }
 
   private parseParenthesizedOrFunction(): ast.Expression {
-    const start = this.consume(TokenType.LPAREN, 'Expected "("');
+    const start = this.consumeSpan(TokenType.LPAREN, 'Expected "("');
 
-    // Empty parens = unit literal
+    // Empty parens = unit literal, or a function taking no parameters
     if (this.match(TokenType.RPAREN)) {
-      return ast.createLiteral('unit', null, mergeSpans(start.span, this.previous().span));
+      if (this.match(TokenType.FAT_ARROW)) {
+        const body = this.parseExpression();
+        return {
+          kind: 'FunctionExpression',
+          params: [],
+          body,
+          span: mergeSpans(start, body.span),
+        };
+      }
+      return ast.createLiteral('unit', null, mergeSpans(start, this.previousSpan()));
     }
 
     // Check if this is a function definition
@@ -537,14 +575,14 @@ export class Parser {
     const params = this.tryParseParams();
     
     if (params && this.check(TokenType.RPAREN)) {
-      this.advance(); // consume )
+      this.skip(); // consume )
       if (this.match(TokenType.FAT_ARROW)) {
         const body = this.parseExpression();
         return {
           kind: 'FunctionExpression',
           params,
           body,
-          span: mergeSpans(start.span, body.span),
+          span: mergeSpans(start, body.span),
         };
       }
     }
@@ -561,19 +599,19 @@ export class Parser {
         params.push(this.parsePattern());
       } while (this.match(TokenType.COMMA));
       
-      this.consume(TokenType.RPAREN, 'Expected ")" after function parameters');
-      this.consume(TokenType.FAT_ARROW, 'Expected "=>" after function parameters');
+      this.expect(TokenType.RPAREN, 'Expected ")" after function parameters');
+      this.expect(TokenType.FAT_ARROW, 'Expected "=>" after function parameters');
       const body = this.parseExpression();
       
       return {
         kind: 'FunctionExpression',
         params,
         body,
-        span: mergeSpans(start.span, body.span),
+        span: mergeSpans(start, body.span),
       };
     }
 
-    this.consume(TokenType.RPAREN, 'Expected ")" after expression');
+    this.expect(TokenType.RPAREN, 'Expected ")" after expression');
 
     // Check if it's followed by =>
     if (this.match(TokenType.FAT_ARROW)) {
@@ -582,7 +620,7 @@ export class Parser {
         kind: 'FunctionExpression',
         params: [this.exprToPattern(expr)],
         body,
-        span: mergeSpans(start.span, body.span),
+        span: mergeSpans(start, body.span),
       };
     }
 
@@ -622,7 +660,7 @@ export class Parser {
   }
 
   private parseListExpression(): ast.ListExpression {
-    const start = this.consume(TokenType.LBRACKET, 'Expected "["');
+    const start = this.consumeSpan(TokenType.LBRACKET, 'Expected "["');
     const elements: ast.Expression[] = [];
 
     if (!this.check(TokenType.RBRACKET)) {
@@ -631,29 +669,29 @@ export class Parser {
       } while (this.match(TokenType.COMMA));
     }
 
-    const end = this.consume(TokenType.RBRACKET, 'Expected "]" after list');
+    const end = this.consumeSpan(TokenType.RBRACKET, 'Expected "]" after list');
 
     return {
       kind: 'ListExpression',
       elements,
-      span: mergeSpans(start.span, end.span),
+      span: mergeSpans(start, end),
     };
   }
 
   private parseRecordOrBlock(): ast.Expression {
-    const start = this.consume(TokenType.LBRACE, 'Expected "{"');
+    const start = this.consumeSpan(TokenType.LBRACE, 'Expected "{"');
 
     // Empty braces = empty record
     if (this.match(TokenType.RBRACE)) {
       return {
         kind: 'RecordExpression',
         fields: [],
-        span: mergeSpans(start.span, this.previous().span),
+        span: mergeSpans(start, this.previousSpan()),
       };
     }
 
     // Check if this is a record (name: value) or block (statements)
-    if (this.check(TokenType.IDENT) && this.peekNext()?.type === TokenType.COLON) {
+    if (this.check(TokenType.IDENT) && this.peekNextType() === TokenType.COLON) {
       return this.parseRecordExpression(start);
     }
 
@@ -666,7 +704,7 @@ export class Parser {
     return this.parseBlockExpression(start);
   }
 
-  private parseRecordExpression(start: Token): ast.RecordExpression {
+  private parseRecordExpression(start: Span): ast.RecordExpression {
     const fields: ast.RecordField[] = [];
     let spread: ast.Expression | undefined;
 
@@ -675,7 +713,7 @@ export class Parser {
         spread = this.parseExpression();
       } else if (this.check(TokenType.IDENT)) {
         const name = this.parseIdentifier();
-        this.consume(TokenType.COLON, 'Expected ":" after field name');
+        this.expect(TokenType.COLON, 'Expected ":" after field name');
         const value = this.parseExpression();
         fields.push({
           kind: 'RecordField',
@@ -686,17 +724,17 @@ export class Parser {
       }
     } while (this.match(TokenType.COMMA));
 
-    const end = this.consume(TokenType.RBRACE, 'Expected "}" after record');
+    const end = this.consumeSpan(TokenType.RBRACE, 'Expected "}" after record');
 
     return {
       kind: 'RecordExpression',
       fields,
       spread,
-      span: mergeSpans(start.span, end.span),
+      span: mergeSpans(start, end),
     };
   }
 
-  private parseBlockExpression(start: Token): ast.BlockExpression {
+  private parseBlockExpression(start: Span): ast.BlockExpression {
     const statements: ast.Statement[] = [];
     let result: ast.Expression | undefined;
 
@@ -717,22 +755,22 @@ export class Parser {
       }
     }
 
-    const end = this.consume(TokenType.RBRACE, 'Expected "}" after block');
+    const end = this.consumeSpan(TokenType.RBRACE, 'Expected "}" after block');
 
     return {
       kind: 'BlockExpression',
       statements,
       result,
-      span: mergeSpans(start.span, end.span),
+      span: mergeSpans(start, end),
     };
   }
 
   private parseIfExpression(): ast.IfExpression {
-    const start = this.consume(TokenType.IF, 'Expected "if"');
+    const start = this.consumeSpan(TokenType.IF, 'Expected "if"');
     const condition = this.parseExpression();
-    this.consume(TokenType.THEN, 'Expected "then" after if condition');
+    this.expect(TokenType.THEN, 'Expected "then" after if condition');
     const thenBranch = this.parseExpression();
-    this.consume(TokenType.ELSE, 'Expected "else" after then branch');
+    this.expect(TokenType.ELSE, 'Expected "else" after then branch');
     const elseBranch = this.parseExpression();
 
     return {
@@ -740,27 +778,27 @@ export class Parser {
       condition,
       thenBranch,
       elseBranch,
-      span: mergeSpans(start.span, elseBranch.span),
+      span: mergeSpans(start, elseBranch.span),
     };
   }
 
   private parseMatchExpression(): ast.MatchExpression {
-    const start = this.consume(TokenType.MATCH, 'Expected "match"');
+    const start = this.consumeSpan(TokenType.MATCH, 'Expected "match"');
     const subject = this.parseExpression();
-    this.consume(TokenType.LBRACE, 'Expected "{" after match subject');
+    this.expect(TokenType.LBRACE, 'Expected "{" after match subject');
 
     const arms: ast.MatchArm[] = [];
     while (!this.check(TokenType.RBRACE) && !this.isAtEnd()) {
       arms.push(this.parseMatchArm());
     }
 
-    const end = this.consume(TokenType.RBRACE, 'Expected "}" after match arms');
+    const end = this.consumeSpan(TokenType.RBRACE, 'Expected "}" after match arms');
 
     return {
       kind: 'MatchExpression',
       subject,
       arms,
-      span: mergeSpans(start.span, end.span),
+      span: mergeSpans(start, end),
     };
   }
 
@@ -772,7 +810,7 @@ export class Parser {
       guard = this.parseExpression();
     }
 
-    this.consume(TokenType.FAT_ARROW, 'Expected "=>" after pattern');
+    this.expect(TokenType.FAT_ARROW, 'Expected "=>" after pattern');
     const body = this.parseExpression();
 
     return {
@@ -785,29 +823,29 @@ export class Parser {
   }
 
   private parseDoExpression(): ast.DoExpression {
-    const start = this.consume(TokenType.DO, 'Expected "do"');
+    const start = this.consumeSpan(TokenType.DO, 'Expected "do"');
     const isResultContext = this.match(TokenType.QUESTION);
-    this.consume(TokenType.LBRACE, 'Expected "{" after do');
+    this.expect(TokenType.LBRACE, 'Expected "{" after do');
 
     const body: ast.DoStatement[] = [];
     while (!this.check(TokenType.RBRACE) && !this.isAtEnd()) {
       body.push(this.parseDoStatement());
     }
 
-    const end = this.consume(TokenType.RBRACE, 'Expected "}" after do block');
+    const end = this.consumeSpan(TokenType.RBRACE, 'Expected "}" after do block');
 
     return {
       kind: 'DoExpression',
       isResultContext,
       body,
-      span: mergeSpans(start.span, end.span),
+      span: mergeSpans(start, end),
     };
   }
 
   private parseDoStatement(): ast.DoStatement {
     if (this.match(TokenType.LET)) {
       const pattern = this.parsePattern();
-      this.consume(TokenType.EQ, 'Expected "=" after pattern');
+      this.expect(TokenType.EQ, 'Expected "=" after pattern');
       
       const isEffect = this.match(TokenType.DO) && this.match(TokenType.BANG);
       const value = this.parseExpression();
@@ -839,15 +877,15 @@ export class Parser {
   }
 
   private parseProvideExpression(): ast.ProvideExpression {
-    const start = this.consume(TokenType.PROVIDE, 'Expected "provide"');
+    const start = this.consumeSpan(TokenType.PROVIDE, 'Expected "provide"');
     const provisions: ast.Provision[] = [];
 
     do {
       provisions.push(this.parseProvision());
     } while (this.match(TokenType.COMMA));
 
-    this.consume(TokenType.IN, 'Expected "in" after provisions');
-    this.consume(TokenType.LBRACE, 'Expected "{" after "in"');
+    this.expect(TokenType.IN, 'Expected "in" after provisions');
+    this.expect(TokenType.LBRACE, 'Expected "{" after "in"');
     
     const bodyStatements: ast.Statement[] = [];
     let bodyResult: ast.Expression | undefined;
@@ -865,43 +903,45 @@ export class Parser {
       }
     }
 
-    const end = this.consume(TokenType.RBRACE, 'Expected "}" after provide body');
+    const end = this.consumeSpan(TokenType.RBRACE, 'Expected "}" after provide body');
 
     const body: ast.BlockExpression = {
       kind: 'BlockExpression',
       statements: bodyStatements,
       result: bodyResult,
-      span: mergeSpans(start.span, end.span),
+      span: mergeSpans(start, end),
     };
 
     return {
       kind: 'ProvideExpression',
       provisions,
       body,
-      span: mergeSpans(start.span, end.span),
+      span: mergeSpans(start, end),
     };
   }
 
   private parseUnaryExpression(): ast.UnaryExpression {
-    const op = this.advance();
+    const opSpan = this.advanceSpan();
+    const operator = this.previousLexeme() as ast.UnaryOperator;
     const operand = this.parsePrecedence(Precedence.UNARY);
 
     return {
       kind: 'UnaryExpression',
-      operator: op.lexeme as ast.UnaryOperator,
+      operator,
       operand,
-      span: mergeSpans(op.span, operand.span),
+      span: mergeSpans(opSpan, operand.span),
     };
   }
 
   private parseBinaryExpression(left: ast.Expression): ast.BinaryExpression {
-    const op = this.advance();
-    const precedence = this.getOperatorPrecedence(op.type);
+    const precedence = this.getOperatorPrecedence(this.peekType());
+    this.skip();
+    const operator = this.previousLexeme() as ast.BinaryOperator;
     const right = this.parsePrecedence(precedence + 1);
 
     return {
       kind: 'BinaryExpression',
-      operator: op.lexeme as ast.BinaryOperator,
+      operator,
       left,
       right,
       span: mergeSpans(left.span, right.span),
@@ -909,7 +949,7 @@ export class Parser {
   }
 
   private parsePipelineExpression(left: ast.Expression): ast.PipelineExpression {
-    this.advance(); // consume |>
+    this.skip(); // consume |>
     
     const isSeq = this.match(TokenType.SEQ);
     let parallelHint: ast.ParallelHint | undefined;
@@ -931,48 +971,56 @@ export class Parser {
   }
 
   private parseParallelHint(): ast.ParallelHint {
-    const start = this.previous().span;
+    const start = this.previousSpan();
     const name = this.parseIdentifier();
     
     if (name.name !== 'parallel') {
       this.error(ErrorCodes.UNEXPECTED_TOKEN, 'Expected @parallel hint');
     }
 
-    this.consume(TokenType.LPAREN, 'Expected "(" after @parallel');
+    this.expect(TokenType.LPAREN, 'Expected "(" after @parallel');
     
     const options: Record<string, ast.Expression> = {};
     if (!this.check(TokenType.RPAREN)) {
       do {
         const key = this.parseIdentifier();
-        this.consume(TokenType.COLON, 'Expected ":" after hint key');
+        if (!(ast.PARALLEL_HINT_OPTIONS as readonly string[]).includes(key.name)) {
+          this.errors.push(createError(
+            ErrorCodes.UNEXPECTED_TOKEN,
+            `Unknown @parallel option "${key.name}"`,
+            key.span,
+            [`Expected one of ${ast.PARALLEL_HINT_OPTIONS.join(', ')}`]
+          ));
+        }
+        this.expect(TokenType.COLON, 'Expected ":" after hint key');
         const value = this.parseExpression();
         options[key.name] = value;
       } while (this.match(TokenType.COMMA));
     }
 
-    const end = this.consume(TokenType.RPAREN, 'Expected ")" after hint options');
+    const end = this.consumeSpan(TokenType.RPAREN, 'Expected ")" after hint options');
 
     return {
       kind: 'ParallelHint',
       options,
-      span: mergeSpans(start, end.span),
+      span: mergeSpans(start, end),
     };
   }
 
   private parseErrorPropagation(left: ast.Expression): ast.BinaryExpression {
-    const op = this.advance();
+    const span = this.advanceSpan();
     
     return {
       kind: 'BinaryExpression',
       operator: '?',
       left,
-      right: ast.createLiteral('unit', null, op.span), // placeholder
-      span: mergeSpans(left.span, op.span),
+      right: ast.createLiteral('unit', null, span), // placeholder
+      span: mergeSpans(left.span, span),
     };
   }
 
   private parseCallExpression(callee: ast.Expression): ast.CallExpression {
-    this.advance(); // consume (
+    this.skip(); // consume (
     const args: ast.Expression[] = [];
 
     if (!this.check(TokenType.RPAREN)) {
@@ -981,18 +1029,18 @@ export class Parser {
       } while (this.match(TokenType.COMMA));
     }
 
-    const end = this.consume(TokenType.RPAREN, 'Expected ")" after arguments');
+    const end = this.consumeSpan(TokenType.RPAREN, 'Expected ")" after arguments');
 
     return {
       kind: 'CallExpression',
       callee,
       args,
-      span: mergeSpans(callee.span, end.span),
+      span: mergeSpans(callee.span, end),
     };
   }
 
   private parseMemberExpression(object: ast.Expression): ast.MemberExpression {
-    this.advance(); // consume .
+    this.skip(); // consume .
     const property = this.parseIdentifier();
 
     return {
@@ -1004,30 +1052,30 @@ export class Parser {
   }
 
   private parseIndexExpression(object: ast.Expression): ast.IndexExpression {
-    this.advance(); // consume [
+    this.skip(); // consume [
     const index = this.parseExpression();
-    const end = this.consume(TokenType.RBRACKET, 'Expected "]" after index');
+    const end = this.consumeSpan(TokenType.RBRACKET, 'Expected "]" after index');
 
     return {
       kind: 'IndexExpression',
       object,
       index,
-      span: mergeSpans(object.span, end.span),
+      span: mergeSpans(object.span, end),
     };
   }
 
   private parsePlaceholder(): ast.PlaceholderExpression {
-    const token = this.advance();
-    return { kind: 'PlaceholderExpression', span: token.span };
+    const span = this.advanceSpan();
+    return { kind: 'PlaceholderExpression', span };
   }
 
   private parseSpread(): ast.SpreadExpression {
-    const start = this.advance();
+    const start = this.advanceSpan();
     const expression = this.parseExpression();
     return {
       kind: 'SpreadExpression',
       expression,
-      span: mergeSpans(start.span, expression.span),
+      span: mergeSpans(start, expression.span),
     };
   }
 
@@ -1036,9 +1084,9 @@ export class Parser {
   // ===========================================================================
 
   private parsePattern(): ast.Pattern {
-    const token = this.peek();
+    const type = this.peekType();
 
-    switch (token.type) {
+    switch (type) {
       case TokenType.IDENT:
         return this.parseIdentifierPattern();
       
@@ -1064,16 +1112,18 @@ export class Parser {
       case TokenType.DOTDOTDOT:
         return this.parseRestPattern();
       
-      default:
-        this.error(ErrorCodes.INVALID_PATTERN, `Invalid pattern: ${token.type}`);
-        this.advance();
-        return { kind: 'WildcardPattern', span: token.span };
+      default: {
+        const span = this.peekSpan();
+        this.error(ErrorCodes.INVALID_PATTERN, `Invalid pattern: ${type}`);
+        this.skip();
+        return { kind: 'WildcardPattern', span };
+      }
     }
   }
 
   private parseIdentifierPattern(): ast.IdentifierPattern {
-    const token = this.advance();
-    return { kind: 'IdentifierPattern', name: token.lexeme, span: token.span };
+    const span = this.advanceSpan();
+    return { kind: 'IdentifierPattern', name: this.previousLexeme(), span };
   }
 
   private parseConstructorPattern(): ast.ConstructorPattern {
@@ -1084,7 +1134,7 @@ export class Parser {
       fields = this.parseRecordPattern();
     } else if (this.match(TokenType.LPAREN)) {
       fields = this.parsePattern();
-      this.consume(TokenType.RPAREN, 'Expected ")" after constructor pattern');
+      this.expect(TokenType.RPAREN, 'Expected ")" after constructor pattern');
     }
 
     return {
@@ -1096,16 +1146,17 @@ export class Parser {
   }
 
   private parseLiteralPattern(): ast.LiteralPattern {
-    const token = this.advance();
+    const type = this.peekType();
+    const span = this.advanceSpan();
     let value: number | string | boolean;
 
-    switch (token.type) {
+    switch (type) {
       case TokenType.INT:
       case TokenType.FLOAT:
-        value = token.value as number;
+        value = this.previousValue() as number;
         break;
       case TokenType.STRING:
-        value = token.value as string;
+        value = this.previousValue() as string;
         break;
       case TokenType.TRUE:
         value = true;
@@ -1114,29 +1165,29 @@ export class Parser {
         value = false;
         break;
       default:
-        throw new Error(`Unexpected literal pattern: ${token.type}`);
+        throw new Error(`Unexpected literal pattern: ${type}`);
     }
 
-    return { kind: 'LiteralPattern', value, span: token.span };
+    return { kind: 'LiteralPattern', value, span };
   }
 
   private parseWildcardPattern(): ast.WildcardPattern {
-    const token = this.advance();
-    return { kind: 'WildcardPattern', span: token.span };
+    const span = this.advanceSpan();
+    return { kind: 'WildcardPattern', span };
   }
 
   private parseListPattern(): ast.ListPattern {
-    const start = this.advance(); // consume [
+    const start = this.advanceSpan(); // consume [
     const elements: ast.Pattern[] = [];
     let rest: ast.IdentifierPattern | undefined;
 
     if (!this.check(TokenType.RBRACKET)) {
       do {
         if (this.check(TokenType.DOTDOTDOT)) {
-          this.advance();
+          this.skip();
           if (this.check(TokenType.IDENT)) {
-            const name = this.advance();
-            rest = { kind: 'IdentifierPattern', name: name.lexeme, span: name.span };
+            const span = this.advanceSpan();
+            rest = { kind: 'IdentifierPattern', name: this.previousLexeme(), span };
           }
           break;
         }
@@ -1144,18 +1195,18 @@ export class Parser {
       } while (this.match(TokenType.COMMA));
     }
 
-    const end = this.consume(TokenType.RBRACKET, 'Expected "]" after list pattern');
+    const end = this.consumeSpan(TokenType.RBRACKET, 'Expected "]" after list pattern');
 
     return {
       kind: 'ListPattern',
       elements,
       rest,
-      span: mergeSpans(start.span, end.span),
+      span: mergeSpans(start, end),
     };
   }
 
   private parseRecordPattern(): ast.RecordPattern {
-    const start = this.check(TokenType.LBRACE) ? this.advance() : this.previous();
+    const start = this.check(TokenType.LBRACE) ? this.advanceSpan() : this.previousSpan();
     const fields: ast.RecordPatternField[] = [];
     let rest = false;
 
@@ -1182,18 +1233,18 @@ export class Parser {
       } while (this.match(TokenType.COMMA));
     }
 
-    const end = this.consume(TokenType.RBRACE, 'Expected "}" after record pattern');
+    const end = this.consumeSpan(TokenType.RBRACE, 'Expected "}" after record pattern');
 
     return {
       kind: 'RecordPattern',
       fields,
       rest,
-      span: mergeSpans(start.span, end.span),
+      span: mergeSpans(start, end),
     };
   }
 
   private parseRestPattern(): ast.RestPattern {
-    const start = this.advance(); // consume ...
+    const start = this.advanceSpan(); // consume ...
     let name: ast.Identifier | undefined;
 
     if (this.check(TokenType.IDENT)) {
@@ -1203,7 +1254,7 @@ export class Parser {
     return {
       kind: 'RestPattern',
       name,
-      span: name ? mergeSpans(start.span, name.span) : start.span,
+      span: name ? mergeSpans(start, name.span) : start,
     };
   }
 
@@ -1225,7 +1276,7 @@ export class Parser {
     // Check for (A, B) -> C function type
     if (this.check(TokenType.LPAREN)) {
       const checkpoint = this.current;
-      this.advance();
+      this.skip();
       
       const params: ast.TypeExpression[] = [];
       
@@ -1262,13 +1313,13 @@ export class Parser {
     }
 
     if (this.check(TokenType.LPAREN)) {
-      const start = this.advance();
+      const start = this.advanceSpan();
       const type = this.parseTypeExpression();
-      this.consume(TokenType.RPAREN, 'Expected ")" after type');
+      this.expect(TokenType.RPAREN, 'Expected ")" after type');
       return {
         kind: 'ParenthesizedType',
         type,
-        span: mergeSpans(start.span, this.previous().span),
+        span: mergeSpans(start, this.previousSpan()),
       };
     }
 
@@ -1294,25 +1345,25 @@ export class Parser {
   }
 
   private parseRecordType(): ast.RecordType {
-    const start = this.advance(); // consume {
+    const start = this.advanceSpan(); // consume {
     const fields = this.parseRecordTypeFields();
-    const end = this.consume(TokenType.RBRACE, 'Expected "}" after record type');
+    const end = this.consumeSpan(TokenType.RBRACE, 'Expected "}" after record type');
 
     return {
       kind: 'RecordType',
       fields,
-      span: mergeSpans(start.span, end.span),
+      span: mergeSpans(start, end),
     };
   }
 
   private parseRecordTypeFields(): ast.RecordTypeFields {
     const fields: ast.RecordTypeField[] = [];
-    const start = this.previous().span;
+    const start = this.previousSpan();
 
     if (!this.check(TokenType.RBRACE)) {
       do {
         const name = this.parseIdentifier();
-        this.consume(TokenType.COLON, 'Expected ":" after field name');
+        this.expect(TokenType.COLON, 'Expected ":" after field name');
         const type = this.parseTypeExpression();
         
         fields.push({
@@ -1327,19 +1378,19 @@ export class Parser {
     return {
       kind: 'RecordTypeFields',
       fields,
-      span: mergeSpans(start, this.peek().span),
+      span: mergeSpans(start, this.peekSpan()),
     };
   }
 
   private parseListType(): ast.ListType {
-    const start = this.advance(); // consume [
+    const start = this.advanceSpan(); // consume [
     const elementType = this.parseTypeExpression();
-    const end = this.consume(TokenType.RBRACKET, 'Expected "]" after list type');
+    const end = this.consumeSpan(TokenType.RBRACKET, 'Expected "]" after list type');
 
     return {
       kind: 'ListType',
       elementType,
-      span: mergeSpans(start.span, end.span),
+      span: mergeSpans(start, end),
     };
   }
 
@@ -1348,24 +1399,37 @@ export class Parser {
   // ===========================================================================
 
   private isAtEnd(): boolean {
-    return this.peek().type === TokenType.EOF;
+    return this.peekType() === TokenType.EOF;
   }
 
-  private peek(): Token {
-    return this.tokens[this.current]!;
+  private peekType(): TokenType {
+    return this.tokens.typeAt(this.current);
   }
 
-  private peekNext(): Token | undefined {
-    return this.tokens[this.current + 1];
+  private peekSpan(): Span {
+    return this.tokens.spanAt(this.current);
   }
 
-  private previous(): Token {
-    return this.tokens[this.current - 1]!;
+  private peekNextType(): TokenType | undefined {
+    if (this.current + 1 >= this.tokens.length) return undefined;
+    return this.tokens.typeAt(this.current + 1);
+  }
+
+  private previousSpan(): Span {
+    return this.tokens.spanAt(this.current - 1);
+  }
+
+  private previousLexeme(): string {
+    return this.tokens.lexemeAt(this.current - 1);
+  }
+
+  private previousValue(): unknown {
+    return this.tokens.valueAt(this.current - 1);
   }
 
   private check(type: TokenType): boolean {
     if (this.isAtEnd()) return false;
-    return this.peek().type === type;
+    return this.peekType() === type;
   }
 
   private checkTypeIdent(): boolean {
@@ -1375,36 +1439,54 @@ export class Parser {
   private match(...types: TokenType[]): boolean {
     for (const type of types) {
       if (this.check(type)) {
-        this.advance();
+        this.skip();
         return true;
       }
     }
     return false;
   }
 
-  private advance(): Token {
+  /**
+   * Advance without materializing the consumed token
+   */
+  private skip(): void {
     if (!this.isAtEnd()) this.current++;
-    return this.previous();
   }
 
-  private consume(type: TokenType, message: string): Token {
-    if (this.check(type)) return this.advance();
+  private advanceSpan(): Span {
+    this.skip();
+    return this.previousSpan();
+  }
+
+  private consumeSpan(type: TokenType, message: string): Span {
+    this.expect(type, message);
+    return this.previousSpan();
+  }
+
+  /**
+   * Like consumeSpan(), for callers that don't need the consumed token's span
+   */
+  private expect(type: TokenType, message: string): void {
+    if (this.check(type)) {
+      this.skip();
+      return;
+    }
     
     this.error(ErrorCodes.UNEXPECTED_TOKEN, message);
     throw new Error(message);
   }
 
   private error(code: string, message: string): void {
-    this.errors.push(createError(code, message, this.peek().span));
+    this.errors.push(createError(code, message, this.peekSpan()));
   }
 
   private synchronize(): void {
-    this.advance();
+    this.skip();
 
     while (!this.isAtEnd()) {
-      if (this.previous().type === TokenType.RBRACE) return;
+      if (this.tokens.typeAt(this.current - 1) === TokenType.RBRACE) return;
 
-      switch (this.peek().type) {
+      switch (this.peekType()) {
         case TokenType.LET:
         case TokenType.TYPE:
         case TokenType.MODULE:
@@ -1412,7 +1494,7 @@ export class Parser {
           return;
       }
 
-      this.advance();
+      this.skip();
     }
   }
 
@@ -1450,7 +1532,7 @@ enum Precedence {
   CALL = 10,
 }
 
-export function parse(tokens: Token[]): ParseResult {
+export function parse(tokens: Token[] | TokenStream): ParseResult {
   const parser = new Parser(tokens);
   return parser.parse();
 }
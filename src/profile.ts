@@ -0,0 +1,173 @@
+/**
+ * Compiler instrumentation: phase timing, heap usage and work counters
+ */
+
+// ============================================================================
+// Profile Types
+// ============================================================================
+
+export interface PhaseProfile {
+  /** Phase name, e.g. 'tokenize' or 'typeCheck' */
+  name: string;
+  /** Start time in milliseconds, relative to the start of compilation */
+  start: number;
+  /** Wall time in milliseconds */
+  duration: number;
+  /**
+   * Change in used heap bytes across the phase, or null where heap usage
+   * cannot be read. Can be negative if a collection ran during the phase.
+   */
+  heapDelta: number | null;
+}
+
+export interface ProfileCounts {
+  /** Tokens produced by the lexer */
+  tokens: number;
+  /** Nodes in the parsed AST */
+  astNodes: number;
+  /** Type variables created by the type checker */
+  typeVars: number;
+  /** Calls to TypeChecker.unify */
+  unifyCalls: number;
+}
+
+export interface CompileProfile {
+  /** Phases in the order they ran */
+  phases: PhaseProfile[];
+  counts: ProfileCounts;
+  /** Total wall time in milliseconds */
+  totalTime: number;
+}
+
+// ============================================================================
+// Profiler
+// ============================================================================
+
+export class Profiler {
+  private origin: number;
+  private phases: PhaseProfile[] = [];
+  readonly counts: ProfileCounts = { tokens: 0, astNodes: 0, typeVars: 0, unifyCalls: 0 };
+
+  constructor() {
+    this.origin = performance.now();
+  }
+
+  /**
+   * Run `fn` as the phase `name` and record its time and heap delta
+   */
+  measure<T>(name: string, fn: () => T): T {
+    const heapBefore = heapUsed();
+    const start = performance.now();
+    const result = fn();
+    const end = performance.now();
+    const heapAfter = heapUsed();
+
+    this.phases.push({
+      name,
+      start: start - this.origin,
+      duration: end - start,
+      heapDelta: heapBefore === null || heapAfter === null ? null : heapAfter - heapBefore,
+    });
+    return result;
+  }
+
+  finish(): CompileProfile {
+    return {
+      phases: this.phases,
+      counts: { ...this.counts },
+      totalTime: performance.now() - this.origin,
+    };
+  }
+}
+
+/**
+ * Used JS heap in bytes, if the host exposes it
+ */
+function heapUsed(): number | null {
+  if (typeof process !== 'undefined' && typeof process.memoryUsage === 'function') {
+    return process.memoryUsage().heapUsed;
+  }
+  // Chromium-only, and coarse unless the page is cross-origin isolated
+  const memory = (performance as { memory?: { usedJSHeapSize: number } }).memory;
+  return memory ? memory.usedJSHeapSize : null;
+}
+
+/**
+ * Count AST nodes (objects with a `kind`) reachable from `node`
+ */
+export function countAstNodes(node: unknown): number {
+  if (Array.isArray(node)) {
+    let count = 0;
+    for (const item of node) count += countAstNodes(item);
+    return count;
+  }
+  if (node === null || typeof node !== 'object') {
+    return 0;
+  }
+
+  let count = 'kind' in node ? 1 : 0;
+  for (const [key, value] of Object.entries(node)) {
+    if (key !== 'span') count += countAstNodes(value);
+  }
+  return count;
+}
+
+// ============================================================================
+// Output
+// ============================================================================
+
+/**
+ * Convert a profile to Chrome trace-event JSON, loadable in
+ * chrome://tracing, Perfetto or the DevTools performance panel
+ */
+export function toChromeTrace(profile: CompileProfile): string {
+  const events: object[] = [
+    { name: 'process_name', ph: 'M', pid: 1, tid: 1, args: { name: 'lambdawg compile' } },
+  ];
+
+  for (const phase of profile.phases) {
+    events.push({
+      name: phase.name,
+      cat: 'compile',
+      ph: 'X',
+      pid: 1,
+      tid: 1,
+      // Trace timestamps are in microseconds
+      ts: Math.round(phase.start * 1000),
+      dur: Math.round(phase.duration * 1000),
+      args: { heapDelta: phase.heapDelta },
+    });
+  }
+
+  events.push({
+    name: 'counts',
+    ph: 'C',
+    pid: 1,
+    tid: 1,
+    ts: Math.round(profile.totalTime * 1000),
+    args: { ...profile.counts },
+  });
+
+  return JSON.stringify({ traceEvents: events, displayTimeUnit: 'ms' });
+}
+
+/**
+ * Format a profile as a human-readable table
+ */
+export function formatProfile(profile: CompileProfile): string {
+  const lines = ['phase            time (ms)    heap delta (KB)'];
+
+  for (const phase of profile.phases) {
+    const heap = phase.heapDelta === null ? '-' : (phase.heapDelta / 1024).toFixed(0);
+    lines.push(
+      `${phase.name.padEnd(17)}${phase.duration.toFixed(2).padStart(9)}${heap.padStart(19)}`
+    );
+  }
+  lines.push(`${'total'.padEnd(17)}${profile.totalTime.toFixed(2).padStart(9)}`);
+  lines.push('');
+
+  const { tokens, astNodes, typeVars, unifyCalls } = profile.counts;
+  lines.push(`tokens: ${tokens}, AST nodes: ${astNodes}, type variables: ${typeVars}, unify calls: ${unifyCalls}`);
+
+  return lines.join('\n');
+}
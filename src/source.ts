@@ -29,6 +29,80 @@ export function createSpan(start: Position, end: Position): Span {
   return { start, end };
 }
 
+/**
+ * Offsets of the first character of every line, computed in a single pass.
+ * Used to turn offsets into positions without rescanning the source.
+ */
+export function computeLineStarts(source: string): number[] {
+  const starts = [0];
+  let i = source.indexOf('\n');
+  while (i !== -1) {
+    starts.push(i + 1);
+    i = source.indexOf('\n', i + 1);
+  }
+  return starts;
+}
+
+/**
+ * Maps offsets to line/column positions using a precomputed line-start table.
+ *
+ * Lookups are O(log lines) in general, and amortized O(1) when offsets are
+ * queried in increasing order (as the lexer does), since the last line found
+ * is remembered and scanned forward from.
+ */
+export class LineMap {
+  private readonly starts: number[];
+  private lastLine = 0;
+
+  constructor(source: string) {
+    this.starts = computeLineStarts(source);
+  }
+
+  get lineCount(): number {
+    return this.starts.length;
+  }
+
+  /** 0-based offset of the start of a 1-based line */
+  lineStart(line: number): number {
+    return this.starts[line - 1] ?? this.starts[this.starts.length - 1]!;
+  }
+
+  positionAt(offset: number): Position {
+    const index = this.lineIndexAt(offset);
+    return createPosition(index + 1, offset - this.starts[index]! + 1, offset);
+  }
+
+  private lineIndexAt(offset: number): number {
+    const starts = this.starts;
+    let index = this.lastLine;
+
+    if (starts[index]! <= offset) {
+      // Scan forward a few lines, then fall back to binary search
+      for (let steps = 0; steps < 8; steps++) {
+        const next = starts[index + 1];
+        if (next === undefined || next > offset) {
+          this.lastLine = index;
+          return index;
+        }
+        index++;
+      }
+    }
+
+    let lo = 0;
+    let hi = starts.length - 1;
+    while (lo < hi) {
+      const mid = (lo + hi + 1) >>> 1;
+      if (starts[mid]! <= offset) {
+        lo = mid;
+      } else {
+        hi = mid - 1;
+      }
+    }
+    this.lastLine = lo;
+    return lo;
+  }
+}
+
 export function mergeSpans(a: Span, b: Span): Span {
   return {
     start: a.start.offset < b.start.offset ? a.start : b.start,
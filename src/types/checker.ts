@@ -21,61 +21,78 @@ import {
   createListType,
   createTypeApp,
   prune,
-  occursIn,
+  unionTypeVars,
+  bindTypeVar,
   typeToString,
   instantiate,
   generalize,
-  freeTypeVars,
+  enterLevel,
+  leaveLevel,
   createScheme,
   resetTypeVarCounter,
+  typeVarCount,
+  deserializeScheme,
+  SerializedScheme,
 } from './types.js';
+import { analyzePurity, PurityMap } from './purity.js';
+import { stronglyConnected } from '../optimize/tailcalls.js';
 
 // ============================================================================
 // Type Environment
 // ============================================================================
 
+/**
+ * Lexically scoped type environment
+ *
+ * All scopes share one map from each name to a stack of its bindings,
+ * innermost last, so a lookup is a single map access however deeply
+ * scopes are nested. Scopes are entered and left in stack order as the
+ * checker walks the tree; leaving one pops the bindings it defined. Names
+ * keep their (possibly empty) stack, so scopes do not write to the map
+ * once a name has been seen.
+ */
 export class TypeEnv {
-  private bindings: Map<string, TypeScheme>;
-  private parent: TypeEnv | null;
-
-  constructor(parent: TypeEnv | null = null) {
-    this.bindings = new Map();
-    this.parent = parent;
-  }
+  private bindings: Map<string, TypeScheme[]> = new Map();
+  /** Stacks pushed to by open scopes, in order */
+  private trail: TypeScheme[][] = [];
+  /** Trail length when each open scope was entered */
+  private scopes: number[] = [];
 
   define(name: string, scheme: TypeScheme): void {
-    this.bindings.set(name, scheme);
+    let stack = this.bindings.get(name);
+    if (!stack) {
+      stack = [];
+      this.bindings.set(name, stack);
+    }
+
+    if (this.scopes.length === 0) {
+      // With no scope open the stack holds at most the top-level binding
+      stack[0] = scheme;
+      return;
+    }
+    stack.push(scheme);
+    this.trail.push(stack);
   }
 
   lookup(name: string): TypeScheme | undefined {
-    const scheme = this.bindings.get(name);
-    if (scheme) return scheme;
-    if (this.parent) return this.parent.lookup(name);
-    return undefined;
+    const stack = this.bindings.get(name);
+    return stack && stack[stack.length - 1];
   }
 
-  extend(): TypeEnv {
-    return new TypeEnv(this);
+  enterScope(): void {
+    this.scopes.push(this.trail.length);
   }
 
-  /**
-   * Get all free type variables in the environment
-   */
-  freeTypeVars(): Set<number> {
-    const vars = new Set<number>();
-    for (const scheme of this.bindings.values()) {
-      for (const v of freeTypeVars(scheme.type)) {
-        if (!scheme.typeVars.includes(v)) {
-          vars.add(v);
-        }
-      }
+  leaveScope(): void {
+    const start = this.scopes.pop()!;
+    while (this.trail.length > start) {
+      this.trail.pop()!.pop();
     }
-    if (this.parent) {
-      for (const v of this.parent.freeTypeVars()) {
-        vars.add(v);
-      }
-    }
-    return vars;
+  }
+
+  /** Number of open scopes; 0 at top level */
+  get depth(): number {
+    return this.scopes.length;
   }
 }
 
@@ -83,34 +100,77 @@ export class TypeEnv {
 // Type Checker
 // ============================================================================
 
+export interface TypeCheckOptions {
+  /**
+   * Top-level declarations already checked in an earlier compilation, e.g.
+   * restored from a CompileCache. They are not re-checked; let statements
+   * bind their cached scheme instead. Nodes inside them get no entry in
+   * `types`.
+   */
+  checked?: Map<ast.Module | ast.Statement, SerializedScheme | null>;
+}
+
+export interface TypeCheckStats {
+  /** Type variables created */
+  typeVars: number;
+  /** Calls to unify, including recursive ones */
+  unifyCalls: number;
+}
+
 export interface TypeCheckResult {
   types: Map<ast.AstNode, Type>;
+  /** Generalized types of the top-level let statements that were checked */
+  schemes: Map<ast.LetStatement, TypeScheme>;
+  /**
+   * Whether each function and let statement in the program is pure,
+   * analyzed when first read
+   */
+  readonly purity: PurityMap;
   errors: CompilerError[];
+  stats: TypeCheckStats;
 }
 
 export class TypeChecker {
   private errors: CompilerError[] = [];
   private types: Map<ast.AstNode, Type> = new Map();
+  private schemes: Map<ast.LetStatement, TypeScheme> = new Map();
   private env: TypeEnv;
+  private unifyCalls = 0;
+  /** The recursive group whose lets are being checked, if any */
+  private group: RecursiveGroup | null = null;
+  /** Whether the let being checked is a member of `group` */
+  private inGroup = false;
+  private functionDepth = 0;
 
   constructor() {
     this.env = this.createGlobalEnv();
   }
 
-  check(program: ast.Program): TypeCheckResult {
+  check(program: ast.Program, options: TypeCheckOptions = {}): TypeCheckResult {
     resetTypeVarCounter();
+    const checked = options.checked ?? new Map();
     
-    for (const stmt of program.statements) {
-      this.checkStatement(stmt, this.env);
-    }
+    this.checkStatements(program.statements, checked);
 
     for (const module of program.modules) {
-      this.checkModule(module);
+      if (!checked.has(module)) {
+        this.checkModule(module);
+      }
     }
 
+    const types = this.types;
+    let purity: PurityMap | undefined;
     return {
-      types: this.types,
+      types,
+      schemes: this.schemes,
+      get purity() {
+        return purity ??= analyzePurity(program, types);
+      },
       errors: this.errors,
+      stats: {
+        typeVars: typeVarCount(),
+        unifyCalls: this.unifyCalls,
+      },
     };
   }
 
@@ -237,10 +297,52 @@ export class TypeChecker {
   }
 
   private checkModule(module: ast.Module): void {
-    const moduleEnv = this.env.extend();
+    this.env.enterScope();
+
+    this.checkStatements(module.body, new Map());
 
-    for (const stmt of module.body) {
-      this.checkStatement(stmt, moduleEnv);
+    this.env.leaveScope();
+  }
+
+  /**
+   * Check a statement list in order, taking the schemes of the lets in
+   * `checked` as given. The functions of a recursive group are checked
+   * at one level, where the lambdas of each may call those bound after
+   * it, and are generalized together once the last is checked.
+   */
+  private checkStatements(statements: ast.Statement[], checked: Map<ast.Module | ast.Statement, SerializedScheme | null>): void {
+    const groups = recursiveGroups(statements);
+    for (const stmt of statements) {
+      const cached = checked.get(stmt);
+      const group = stmt.kind === 'LetStatement' ? groups.get(stmt) : undefined;
+      if (group && cached === undefined && !this.group) {
+        // Bound outside each member's let, so that none is generalized
+        // over the functions it calls
+        enterLevel();
+        for (const member of group.members) {
+          group.types.set(member.name.name, freshTypeVar());
+        }
+        this.group = group;
+      }
+
+      if (cached === undefined) {
+        this.inGroup = stmt.kind === 'LetStatement' && this.group?.members.has(stmt) === true;
+        this.checkStatement(stmt, this.env);
+        this.inGroup = false;
+        if (this.group && stmt.kind === 'LetStatement') this.group.checked.push(stmt);
+      } else if (cached && stmt.kind === 'LetStatement') {
+        this.env.define(stmt.name.name, deserializeScheme(cached));
+      }
+
+      if (this.group?.last === stmt) {
+        leaveLevel();
+        for (const checkedLet of this.group.checked) {
+          const scheme = generalize(this.types.get(checkedLet)!);
+          this.env.define(checkedLet.name.name, scheme);
+          if (this.env.depth === 0) this.schemes.set(checkedLet, scheme);
+        }
+        this.group = null;
+      }
     }
   }
 
@@ -262,24 +364,59 @@ export class TypeChecker {
   }
 
   private checkLetStatement(stmt: ast.LetStatement, env: TypeEnv): void {
+    // Variables created from here until leaveLevel() that do not escape
+    // into the environment are generalized
+    enterLevel();
+
     // If there's a type annotation, use it
     let declaredType: Type | null = null;
     if (stmt.typeAnnotation) {
       declaredType = this.typeExprToType(stmt.typeAnnotation);
     }
 
+    // A function may call itself: its name is bound in its own body, to
+    // the type being inferred, which in a recursive group is the type the
+    // members before it already gave it
+    const ahead = this.group?.members.has(stmt) ? this.group.types.get(stmt.name.name) : undefined;
+    const self = stmt.value.kind === 'FunctionExpression' ? ahead ?? freshTypeVar() : null;
+    if (self) {
+      env.define(stmt.name.name, createScheme([], self));
+    }
+
+    // Ambients are supplied by the caller, so they may hold anything their
+    // declared type allows
+    const ambients = stmt.ambients?.ambients ?? [];
+    if (ambients.length > 0) {
+      env.enterScope();
+      for (const ambient of ambients) {
+        const type = ambient.type ? this.typeExprToType(ambient.type) : freshTypeVar();
+        env.define(ambient.name.name, createScheme([], type));
+      }
+    }
+
     // Infer the type of the value
     const inferredType = this.inferExpr(stmt.value, env);
+    if (ambients.length > 0) {
+      env.leaveScope();
+    }
+    if (self) {
+      this.unify(self, inferredType, stmt.span);
+    }
 
     // Unify with declared type if present
     if (declaredType) {
       this.unify(declaredType, inferredType, stmt.span);
     }
 
+    leaveLevel();
+
     // Generalize and add to environment
-    const scheme = generalize(inferredType, env.freeTypeVars());
+    const scheme = generalize(inferredType);
     env.define(stmt.name.name, scheme);
     this.types.set(stmt, inferredType);
+    if (env.depth === 0) {
+      this.schemes.set(stmt, scheme);
+    }
   }
 
   private checkTypeDefinition(stmt: ast.TypeDefinition, env: TypeEnv): void {
@@ -392,6 +529,9 @@ export class TypeChecker {
 
   private inferIdentifier(ident: ast.Identifier, env: TypeEnv): Type {
     const scheme = env.lookup(ident.name);
+    // Lambdas of a recursive group's members may call those bound later
+    const ahead = this.inGroup && this.functionDepth > 0 && !scheme ? this.group!.types.get(ident.name) : undefined;
+    if (ahead) return ahead;
     if (!scheme) {
       this.error(
         ErrorCodes.UNDEFINED_VARIABLE,
@@ -440,16 +580,19 @@ export class TypeChecker {
   }
 
   private inferFunction(func: ast.FunctionExpression, env: TypeEnv): Type {
-    const funcEnv = env.extend();
+    env.enterScope();
+    this.functionDepth++;
     const paramTypes: Type[] = [];
 
     for (const param of func.params) {
       const paramType = freshTypeVar();
       paramTypes.push(paramType);
-      this.bindPattern(param, paramType, funcEnv);
+      this.bindPattern(param, paramType, env);
     }
 
-    const returnType = this.inferExpr(func.body, funcEnv);
+    const returnType = this.inferExpr(func.body, env);
+    this.functionDepth--;
+    env.leaveScope();
     return createFuncType(paramTypes, returnType);
   }
 
@@ -586,6 +729,13 @@ export class TypeChecker {
   }
 
   private inferPipeline(pipe: ast.PipelineExpression, env: TypeEnv): Type {
+    // Hint options are element counts
+    if (pipe.parallelHint) {
+      for (const option of Object.values(pipe.parallelHint.options)) {
+        this.unify(this.inferExpr(option, env), TYPE_INT, option.span);
+      }
+    }
+
     const leftType = this.inferExpr(pipe.left, env);
     const rightType = prune(this.inferExpr(pipe.right, env));
 
@@ -624,15 +774,16 @@ export class TypeChecker {
     let resultType: Type | null = null;
 
     for (const arm of match.arms) {
-      const armEnv = env.extend();
-      this.checkPattern(arm.pattern, subjectType, armEnv);
+      env.enterScope();
+      this.checkPattern(arm.pattern, subjectType, env);
 
       if (arm.guard) {
-        const guardType = this.inferExpr(arm.guard, armEnv);
+        const guardType = this.inferExpr(arm.guard, env);
         this.unify(guardType, TYPE_BOOL, arm.guard.span);
       }
 
-      const bodyType = this.inferExpr(arm.body, armEnv);
+      const bodyType = this.inferExpr(arm.body, env);
+      env.leaveScope();
       
       if (resultType === null) {
         resultType = bodyType;
@@ -645,52 +796,54 @@ export class TypeChecker {
   }
 
   private inferDo(doExpr: ast.DoExpression, env: TypeEnv): Type {
-    const doEnv = env.extend();
+    env.enterScope();
     let lastType: Type = TYPE_UNIT;
 
     for (const stmt of doExpr.body) {
       switch (stmt.kind) {
         case 'DoLetStatement': {
-          const valueType = this.inferExpr(stmt.value, doEnv);
-          this.bindPattern(stmt.pattern, valueType, doEnv);
+          const valueType = this.inferExpr(stmt.value, env);
+          this.bindPattern(stmt.pattern, valueType, env);
           lastType = valueType;
           break;
         }
         case 'DoEffectStatement':
-          lastType = this.inferExpr(stmt.expression, doEnv);
+          lastType = this.inferExpr(stmt.expression, env);
           break;
         case 'DoExprStatement':
-          lastType = this.inferExpr(stmt.expression, doEnv);
+          lastType = this.inferExpr(stmt.expression, env);
           break;
       }
     }
 
+    env.leaveScope();
     return lastType;
   }
 
   private inferBlock(block: ast.BlockExpression, env: TypeEnv): Type {
-    const blockEnv = env.extend();
+    env.enterScope();
 
     for (const stmt of block.statements) {
-      this.checkStatement(stmt, blockEnv);
+      this.checkStatement(stmt, env);
     }
 
-    if (block.result) {
-      return this.inferExpr(block.result, blockEnv);
-    }
-
-    return TYPE_UNIT;
+    const resultType = block.result ? this.inferExpr(block.result, env) : TYPE_UNIT;
+    env.leaveScope();
+    return resultType;
   }
 
   private inferProvide(provide: ast.ProvideExpression, env: TypeEnv): Type {
-    const provideEnv = env.extend();
+    // Provided values are inferred outside the scope they are bound in
+    const valueTypes = provide.provisions.map(provision => this.inferExpr(provision.value, env));
 
-    for (const provision of provide.provisions) {
-      const valueType = this.inferExpr(provision.value, env);
-      provideEnv.define(provision.name.name, createScheme([], valueType));
-    }
+    env.enterScope();
+    provide.provisions.forEach((provision, i) => {
+      env.define(provision.name.name, createScheme([], valueTypes[i]!));
+    });
 
-    return this.inferExpr(provide.body, provideEnv);
+    const bodyType = this.inferExpr(provide.body, env);
+    env.leaveScope();
+    return bodyType;
   }
 
   // ===========================================================================
@@ -737,9 +890,23 @@ export class TypeChecker {
         break;
       }
       
-      case 'ConstructorPattern':
-        // Would need to look up the constructor type
+      case 'ConstructorPattern': {
+        // Built-in constructors constrain the subject and payload; others
+        // (user types are not checked yet) bind the payload to a fresh type
+        const scheme = env.lookup(pattern.name.name);
+        const constructorType = scheme ? prune(instantiate(scheme)) : null;
+        let payloadType: Type = freshTypeVar();
+        if (constructorType?.kind === 'TypeFunc' && constructorType.params.length === 1) {
+          payloadType = constructorType.params[0]!;
+          this.unify(expectedType, constructorType.returnType, pattern.span);
+        } else if (constructorType && !pattern.fields) {
+          this.unify(expectedType, constructorType, pattern.span);
+        }
+        if (pattern.fields) {
+          this.checkPattern(pattern.fields, payloadType, env);
+        }
         break;
+      }
       
       case 'RestPattern':
         if (pattern.name) {
@@ -823,20 +990,29 @@ export class TypeChecker {
   // ===========================================================================
 
   private unify(a: Type, b: Type, span: Span): boolean {
+    this.unifyCalls++;
     a = prune(a);
     b = prune(b);
 
+    // Equal ground types are interned, so this covers most repeated shapes
+    if (a === b) {
+      return true;
+    }
+
     if (a.kind === 'TypeVar') {
-      if (a !== b) {
-        if (occursIn(a, b)) {
-          this.error(
-            ErrorCodes.INFINITE_TYPE,
-            `Infinite type: ${typeToString(a)} = ${typeToString(b)}`,
-            span
-          );
-          return false;
+      if (b.kind === 'TypeVar') {
+        if (a !== b) {
+          unionTypeVars(a, b);
         }
-        a.instance = b;
+        return true;
+      }
+      if (!bindTypeVar(a, b)) {
+        this.error(
+          ErrorCodes.INFINITE_TYPE,
+          `Infinite type: ${typeToString(a)} = ${typeToString(b)}`,
+          span
+        );
+        return false;
       }
       return true;
     }
@@ -929,8 +1105,83 @@ export class TypeChecker {
   }
 }
 
-export function typeCheck(program: ast.Program): TypeCheckResult {
+/**
+ * Functions bound by the lets of one statement list that call each other,
+ * directly or not. Only declarations lie between the first and the last,
+ * so none is called before all are bound.
+ */
+interface RecursiveGroup {
+  members: Set<ast.LetStatement>;
+  last: ast.LetStatement;
+  /** Type of each member while the group is checked, by name */
+  types: Map<string, TypeVar>;
+  /** Lets of the list checked since the first member */
+  checked: ast.LetStatement[];
+}
+
+/**
+ * The recursive groups of a statement list, by first member. A name in a
+ * function refers to the latest let of it before the function or, failing
+ * that, to the first function let of it after.
+ */
+function recursiveGroups(statements: ast.Statement[]): Map<ast.LetStatement, RecursiveGroup> {
+  const functions: ast.LetStatement[] = [];
+  const positions: number[] = [];
+  statements.forEach((stmt, i) => {
+    if (stmt.kind === 'LetStatement' && stmt.value.kind === 'FunctionExpression') {
+      functions.push(stmt);
+      positions.push(i);
+    }
+  });
+  const edges = functions.map((fn, i) => {
+    const targets: number[] = [];
+    for (const name of mentionedNames(fn.value)) {
+      let target = -1;
+      functions.forEach((other, j) => {
+        if (other.name.name !== name || j === i) return;
+        if (j < i || target === -1 || (target > i && j < target)) target = j;
+      });
+      if (target !== -1) targets.push(target);
+    }
+    return targets;
+  });
+
+  const groups = new Map<ast.LetStatement, RecursiveGroup>();
+  let end = -1;
+  for (const component of stronglyConnected(edges).sort((a, b) => Math.min(...a) - Math.min(...b))) {
+    if (component.length < 2) continue;
+    const first = positions[Math.min(...component)]!;
+    const last = positions[Math.max(...component)]!;
+    const declarations = statements.slice(first, last + 1).every(stmt =>
+      stmt.kind === 'TypeDefinition' || stmt.kind === 'ImportStatement' ||
+      (stmt.kind === 'LetStatement' && stmt.value.kind === 'FunctionExpression'));
+    if (!declarations || first <= end) continue;
+    end = last;
+    groups.set(statements[first] as ast.LetStatement, {
+      members: new Set(component.map(i => functions[i]!)),
+      last: statements[last] as ast.LetStatement,
+      types: new Map(),
+      checked: [],
+    });
+  }
+  return groups;
+}
+
+/**
+ * Every identifier name in `node`
+ */
+function mentionedNames(node: ast.AstNode): Set<string> {
+  const names = new Set<string>();
+  JSON.stringify(node, (key, value) => {
+    if (key === 'span') return undefined;
+    if (value?.kind === 'Identifier') names.add(value.name);
+    return value;
+  });
+  return names;
+}
+
+export function typeCheck(program: ast.Program, options?: TypeCheckOptions): TypeCheckResult {
   const checker = new TypeChecker();
-  return checker.check(program);
+  return checker.check(program, options);
 }
 
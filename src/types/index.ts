@@ -1,5 +1,7 @@
 export { TypeChecker, typeCheck, TypeEnv } from './checker.js';
-export type { TypeCheckResult } from './checker.js';
+export type { TypeCheckResult, TypeCheckOptions, TypeCheckStats } from './checker.js';
+export { PurityAnalyzer, analyzePurity, PURE_BUILTINS } from './purity.js';
+export type { Purity, PurityMap } from './purity.js';
 export {
   TYPE_INT,
   TYPE_FLOAT,
@@ -8,15 +10,19 @@ export {
   TYPE_BOOL,
   TYPE_UNIT,
   freshTypeVar,
+  createTypeConst,
   createFuncType,
   createRecordType,
   createListType,
   createTypeApp,
   createScheme,
   prune,
+  isGround,
   typeToString,
   instantiate,
   generalize,
+  serializeScheme,
+  deserializeScheme,
 } from './types.js';
 
 export type {
@@ -28,4 +34,6 @@ export type {
   TypeList,
   TypeApp,
   TypeScheme,
+  SerializedType,
+  SerializedScheme,
 } from './types.js';
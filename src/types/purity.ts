@@ -0,0 +1,474 @@
+/**
+ * Purity analysis for Lambdawg
+ *
+ * Marks every function and let binding as pure or effectful. Effects come
+ * from `do` blocks, from calling values the analysis cannot see into
+ * (parameters, ambients, imported JavaScript) and from calling effectful
+ * functions. Bindings that refer to each other are solved together, so
+ * recursion on its own does not make a function effectful.
+ */
+
+import * as ast from '../parser/ast.js';
+import { Type, prune } from './types.js';
+
+// ============================================================================
+// Purity Types
+// ============================================================================
+
+export type Purity = 'pure' | 'effectful';
+
+/**
+ * Purity of calling each function expression, and of each let statement:
+ * evaluating its value and, if that may be a function, calling it
+ */
+export type PurityMap = Map<ast.LetStatement | ast.FunctionExpression, Purity>;
+
+/**
+ * Built-ins with no effects of their own, with the argument each one
+ * calls (or null)
+ */
+export const PURE_BUILTINS: ReadonlyMap<string, number | null> = new Map([
+  ['map', 0],
+  ['filter', 0],
+  ['fold', 0],
+  ['tap', 0],
+  ['sum', null],
+  ['length', null],
+  ['head', null],
+  ['tail', null],
+  ['show', null],
+  ['identity', null],
+  ['Ok', null],
+  ['Error', null],
+  ['Some', null],
+  ['None', null],
+]);
+
+/** Whether some evaluation can have an effect */
+interface Fact {
+  effectful: boolean;
+  /** Facts that are effectful if this one is */
+  dependents: Fact[] | null;
+}
+
+/** What a name in scope refers to */
+type Binding =
+  | { kind: 'let'; stmt: ast.LetStatement }
+  | { kind: 'module'; members: Map<string, ast.LetStatement> }
+  | { kind: 'opaque' };
+
+const OPAQUE: Binding = { kind: 'opaque' };
+const NO_NAMES: string[] = [];
+
+// ============================================================================
+// Purity Analyzer
+// ============================================================================
+
+export class PurityAnalyzer {
+  private scopes = new Map<string, Binding[]>();
+  /** Calling each function expression */
+  private functionFacts = new Map<ast.FunctionExpression, Fact>();
+  /** Evaluating the value of each let statement */
+  private valueFacts = new Map<ast.LetStatement, Fact>();
+  /** Calling the value of each let statement not bound to a lambda */
+  private callFacts = new Map<ast.LetStatement, Fact>();
+
+  /**
+   * Analyze a program. `types` (from the type checker) tells which lets
+   * cannot hold functions; lets without a type are assumed to.
+   */
+  analyze(program: ast.Program, types?: Map<ast.AstNode, Type>): PurityMap {
+    const bindings: [string, Binding][] = [];
+    for (const module of program.modules) {
+      const members = new Map<string, ast.LetStatement>();
+      for (const stmt of module.body) {
+        if (stmt.kind === 'LetStatement') members.set(stmt.name.name, stmt);
+      }
+      bindings.push([module.name.name, { kind: 'module', members }]);
+    }
+    declareStatements(program.statements, bindings);
+
+    this.bind(bindings);
+    for (const module of program.modules) {
+      const scope = declareStatements(module.body, []);
+      this.bind(scope);
+      for (const stmt of module.body) this.visitStatement(stmt, null);
+      this.unbind(scope.map(([name]) => name));
+    }
+    for (const stmt of program.statements) this.visitStatement(stmt, null);
+
+    this.propagate();
+
+    const purity: PurityMap = new Map();
+    for (const [fn, fact] of this.functionFacts) {
+      purity.set(fn, fact.effectful ? 'effectful' : 'pure');
+    }
+    for (const [stmt, fact] of this.valueFacts) {
+      const called = this.callFact(stmt);
+      const pure = !fact.effectful && (!called.effectful || !mayBeFunction(stmt, types));
+      purity.set(stmt, pure ? 'pure' : 'effectful');
+    }
+    return purity;
+  }
+
+  // ===========================================================================
+  // Facts
+  // ===========================================================================
+
+  private fact<K>(facts: Map<K, Fact>, key: K): Fact {
+    let fact = facts.get(key);
+    if (fact === undefined) {
+      fact = { effectful: false, dependents: null };
+      facts.set(key, fact);
+    }
+    return fact;
+  }
+
+  /** `owner` is effectful if `fact` is */
+  private dependOn(owner: Fact | null, fact: Fact): void {
+    if (owner === null || owner === fact) return;
+    if (fact.dependents === null) fact.dependents = [];
+    fact.dependents.push(owner);
+  }
+
+  /** Calling the value of a let, the same fact as calling its lambda if it has one */
+  private callFact(stmt: ast.LetStatement): Fact {
+    return stmt.value.kind === 'FunctionExpression' && !hasAmbients(stmt)
+      ? this.fact(this.functionFacts, stmt.value)
+      : this.fact(this.callFacts, stmt);
+  }
+
+  private effect(owner: Fact | null): void {
+    if (owner !== null) owner.effectful = true;
+  }
+
+  private propagate(): void {
+    const pending: Fact[] = [];
+    for (const facts of [this.functionFacts, this.valueFacts, this.callFacts]) {
+      for (const fact of facts.values()) {
+        if (fact.effectful) pending.push(fact);
+      }
+    }
+
+    while (pending.length > 0) {
+      for (const dependent of pending.pop()!.dependents ?? []) {
+        if (!dependent.effectful) {
+          dependent.effectful = true;
+          pending.push(dependent);
+        }
+      }
+    }
+  }
+
+  // ===========================================================================
+  // Traversal
+  // ===========================================================================
+
+  /**
+   * Record the effects of evaluating `stmt` as part of `owner`, or of
+   * nothing for top-level code
+   */
+  private visitStatement(stmt: ast.Statement, owner: Fact | null): void {
+    if (stmt.kind === 'ExpressionStatement') {
+      this.visit(stmt.expression, owner);
+      return;
+    }
+    if (stmt.kind !== 'LetStatement') return;
+
+    const value = this.fact(this.valueFacts, stmt);
+    this.dependOn(owner, value);
+    if (!hasAmbients(stmt)) {
+      this.visit(stmt.value, value);
+      if (stmt.value.kind !== 'FunctionExpression') this.callEffects(stmt.value, this.callFact(stmt));
+      return;
+    }
+
+    const ambients = stmt.ambients!.ambients.map(a => a.name.name);
+    const bound = this.bindOpaque(ambients);
+    this.visit(stmt.value, value);
+    this.unbind(bound);
+    // Ambients are the capabilities effects are performed with
+    this.callFact(stmt).effectful = true;
+  }
+
+  private visit(expr: ast.Expression, owner: Fact | null): void {
+    switch (expr.kind) {
+      case 'Identifier':
+      case 'Literal':
+      case 'PlaceholderExpression':
+        break;
+      case 'ListExpression':
+        for (const element of expr.elements) this.visit(element, owner);
+        break;
+      case 'RecordExpression':
+        if (expr.spread) this.visit(expr.spread, owner);
+        for (const field of expr.fields) this.visit(field.value, owner);
+        break;
+      case 'FunctionExpression': {
+        const names: string[] = [];
+        for (const param of expr.params) ast.patternNames(param, names);
+        const bound = this.bindOpaque(names);
+        this.visit(expr.body, this.fact(this.functionFacts, expr));
+        this.unbind(bound);
+        break;
+      }
+      case 'CallExpression':
+        this.visit(expr.callee, owner);
+        for (const arg of expr.args) this.visit(arg, owner);
+        // With placeholders this is a partial application, which calls nothing yet
+        if (placeholders(expr.args) === 0) {
+          this.callWith(expr.callee, expr.args, owner);
+        }
+        break;
+      case 'MemberExpression':
+        this.visit(expr.object, owner);
+        break;
+      case 'IndexExpression':
+        this.visit(expr.object, owner);
+        this.visit(expr.index, owner);
+        break;
+      case 'UnaryExpression':
+        this.visit(expr.operand, owner);
+        break;
+      case 'BinaryExpression':
+        this.visit(expr.left, owner);
+        this.visit(expr.right, owner);
+        break;
+      case 'PipelineExpression': {
+        if (expr.parallelHint) {
+          for (const option of Object.values(expr.parallelHint.options)) this.visit(option, owner);
+        }
+        this.visit(expr.left, owner);
+        this.visit(expr.right, owner);
+        const right = expr.right;
+        if (right.kind === 'CallExpression' && placeholders(right.args) === 1) {
+          const args = right.args.map(arg => arg.kind === 'PlaceholderExpression' ? expr.left : arg);
+          this.callWith(right.callee, args, owner);
+        } else {
+          this.callWith(right, [expr.left], owner);
+        }
+        break;
+      }
+      case 'IfExpression':
+        this.visit(expr.condition, owner);
+        this.visit(expr.thenBranch, owner);
+        this.visit(expr.elseBranch, owner);
+        break;
+      case 'MatchExpression':
+        this.visit(expr.subject, owner);
+        for (const arm of expr.arms) {
+          const names = ast.patternNames(arm.pattern);
+          const bound = this.bindOpaque(names);
+          if (arm.guard) this.visit(arm.guard, owner);
+          this.visit(arm.body, owner);
+          this.unbind(bound);
+        }
+        break;
+      case 'DoExpression': {
+        this.effect(owner);
+        const names = expr.body.flatMap(stmt => stmt.kind === 'DoLetStatement' ? ast.patternNames(stmt.pattern) : []);
+        const bound = this.bindOpaque(names);
+        for (const stmt of expr.body) {
+          this.visit(stmt.kind === 'DoLetStatement' ? stmt.value : stmt.expression, owner);
+        }
+        this.unbind(bound);
+        break;
+      }
+      case 'DoEffectExpression':
+        this.effect(owner);
+        this.visit(expr.expression, owner);
+        break;
+      case 'SpreadExpression':
+        this.visit(expr.expression, owner);
+        break;
+      case 'BlockExpression': {
+        const bindings = declareStatements(expr.statements, []);
+        this.bind(bindings);
+        for (const stmt of expr.statements) this.visitStatement(stmt, owner);
+        if (expr.result) this.visit(expr.result, owner);
+        this.unbind(bindings.map(([name]) => name));
+        break;
+      }
+      case 'ProvideExpression': {
+        for (const provision of expr.provisions) this.visit(provision.value, owner);
+        const names = expr.provisions.map(p => p.name.name);
+        const bound = this.bindOpaque(names);
+        this.visit(expr.body, owner);
+        this.unbind(bound);
+        break;
+      }
+    }
+  }
+
+  /**
+   * Record the effects of calling `callee` with `args`, whose evaluation
+   * has been recorded already
+   */
+  private callWith(callee: ast.Expression, args: ast.Expression[], owner: Fact | null): void {
+    const called = this.builtinCalls(callee);
+    if (called === undefined) {
+      this.callEffects(callee, owner);
+    } else if (called !== null) {
+      const fn = args[called];
+      if (fn === undefined || fn.kind === 'PlaceholderExpression') {
+        this.effect(owner);
+      } else {
+        this.callEffects(fn, owner);
+      }
+    }
+  }
+
+  /**
+   * Record the effects of calling the value of `fn`
+   */
+  private callEffects(fn: ast.Expression, owner: Fact | null): void {
+    switch (fn.kind) {
+      case 'FunctionExpression':
+        this.dependOn(owner, this.fact(this.functionFacts, fn));
+        return;
+
+      case 'Identifier': {
+        const binding = this.lookup(fn.name);
+        if (binding?.kind === 'let') {
+          this.dependOn(owner, this.callFact(binding.stmt));
+        } else if (binding !== undefined || PURE_BUILTINS.get(fn.name) !== null) {
+          // Unknown values, and built-ins that call an unknown function
+          this.effect(owner);
+        }
+        return;
+      }
+
+      case 'MemberExpression': {
+        const binding = fn.object.kind === 'Identifier' ? this.lookup(fn.object.name) : undefined;
+        const member = binding?.kind === 'module' ? binding.members.get(fn.property.name) : undefined;
+        if (member) {
+          this.dependOn(owner, this.callFact(member));
+        } else {
+          this.effect(owner);
+        }
+        return;
+      }
+
+      case 'CallExpression':
+        if (placeholders(fn.args) > 0) {
+          this.callWith(fn.callee, fn.args, owner);
+        } else {
+          this.effect(owner);
+        }
+        return;
+
+      default:
+        this.effect(owner);
+    }
+  }
+
+  /**
+   * Which argument a call of the built-in `callee` calls: null for none,
+   * undefined if `callee` is not a built-in
+   */
+  private builtinCalls(callee: ast.Expression): number | null | undefined {
+    if (callee.kind !== 'Identifier' || this.lookup(callee.name) !== undefined) return undefined;
+    return PURE_BUILTINS.get(callee.name);
+  }
+
+  // ===========================================================================
+  // Scopes
+  // ===========================================================================
+
+  private lookup(name: string): Binding | undefined {
+    const stack = this.scopes.get(name);
+    return stack === undefined || stack.length === 0 ? undefined : stack[stack.length - 1];
+  }
+
+  private bind(bindings: [string, Binding][]): void {
+    for (const [name, binding] of bindings) {
+      let stack = this.scopes.get(name);
+      if (stack === undefined) {
+        stack = [];
+        this.scopes.set(name, stack);
+      }
+      stack.push(binding);
+    }
+  }
+
+  /**
+   * Bind `names` to unknown values, returning the names that needed it:
+   * a name no scope has bound reads as unknown anyway unless it is a
+   * built-in
+   */
+  private bindOpaque(names: string[]): string[] {
+    let bound = NO_NAMES;
+    for (const name of names) {
+      const stack = this.scopes.get(name);
+      if (stack !== undefined) {
+        stack.push(OPAQUE);
+      } else if (PURE_BUILTINS.has(name)) {
+        this.scopes.set(name, [OPAQUE]);
+      } else {
+        continue;
+      }
+      if (bound === NO_NAMES) bound = [];
+      bound.push(name);
+    }
+    return bound;
+  }
+
+  /** Leave the scope that bound `names`. Emptied stacks stay in the map. */
+  private unbind(names: string[]): void {
+    for (const name of names) this.scopes.get(name)!.pop();
+  }
+}
+
+function placeholders(args: ast.Expression[]): number {
+  let count = 0;
+  for (const arg of args) {
+    if (arg.kind === 'PlaceholderExpression') count++;
+  }
+  return count;
+}
+
+function hasAmbients(stmt: ast.LetStatement): boolean {
+  return stmt.ambients !== undefined && stmt.ambients.ambients.length > 0;
+}
+
+/**
+ * Add the bindings a list of statements makes in its scope
+ */
+function declareStatements(statements: ast.Statement[], bindings: [string, Binding][]): [string, Binding][] {
+  for (const stmt of statements) {
+    if (stmt.kind === 'LetStatement') {
+      bindings.push([stmt.name.name, { kind: 'let', stmt }]);
+    } else {
+      for (const name of ast.statementNames(stmt)) bindings.push([name, OPAQUE]);
+    }
+  }
+  return bindings;
+}
+
+/**
+ * Whether a let may hold a function, going by its inferred type if known
+ */
+function mayBeFunction(stmt: ast.LetStatement, types?: Map<ast.AstNode, Type>): boolean {
+  const type = types?.get(stmt);
+  if (type === undefined) {
+    switch (stmt.value.kind) {
+      case 'Literal':
+      case 'ListExpression':
+      case 'RecordExpression':
+      case 'UnaryExpression':
+      case 'BinaryExpression':
+        return false;
+      default:
+        return true;
+    }
+  }
+  const kind = prune(type).kind;
+  return kind === 'TypeFunc' || kind === 'TypeVar';
+}
+
+/**
+ * Mark every function and let binding in a program as pure or effectful
+ */
+export function analyzePurity(program: ast.Program, types?: Map<ast.AstNode, Type>): PurityMap {
+  return new PurityAnalyzer().analyze(program, types);
+}
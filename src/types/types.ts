@@ -5,12 +5,38 @@
 // Type variable counter for generating unique type variables
 let typeVarCounter = 0;
 
+// Let-nesting depth of the binding being inferred; see TypeVar.level
+let currentLevel = 0;
+
 export function resetTypeVarCounter(): void {
   typeVarCounter = 0;
+  currentLevel = 0;
+  internTable.clear();
+}
+
+/**
+ * Enter the right-hand side of a let binding
+ */
+export function enterLevel(): void {
+  currentLevel++;
+}
+
+/**
+ * Leave the right-hand side of a let binding
+ */
+export function leaveLevel(): void {
+  currentLevel--;
+}
+
+/**
+ * Number of type variables created since the last reset
+ */
+export function typeVarCount(): number {
+  return typeVarCounter;
 }
 
 export function freshTypeVar(): TypeVar {
-  return { kind: 'TypeVar', id: typeVarCounter++, instance: null };
+  return { kind: 'TypeVar', id: typeVarCounter++, instance: null, rank: 0, level: currentLevel };
 }
 
 // ============================================================================
@@ -27,11 +53,22 @@ export type Type =
 
 /**
  * Type variable - can be unified with other types
+ *
+ * Type variables form a union-find forest: `instance` is the parent link,
+ * set during unification either to another variable or to the type the
+ * variable stands for. `prune` finds the representative.
  */
 export interface TypeVar {
   kind: 'TypeVar';
   id: number;
   instance: Type | null;  // Set during unification
+  rank: number;  // Upper bound on the height of the tree below this root
+  /**
+   * Outermost let level at which the variable is reachable from the
+   * environment. Variables above the current level after inferring a
+   * binding are not in the environment and can be generalized.
+   */
+  level: number;
 }
 
 /**
@@ -40,6 +77,7 @@ export interface TypeVar {
 export interface TypeConst {
   kind: 'TypeConst';
   name: string;
+  internId: number;  // Nonzero for hash-consed ground types; see Interning
 }
 
 /**
@@ -49,6 +87,7 @@ export interface TypeFunc {
   kind: 'TypeFunc';
   params: Type[];
   returnType: Type;
+  internId: number;  // Nonzero for hash-consed ground types; see Interning
 }
 
 /**
@@ -58,6 +97,7 @@ export interface TypeRecord {
   kind: 'TypeRecord';
   fields: Map<string, Type>;
   isOpen: boolean;  // true if record can have additional fields (row polymorphism)
+  internId: number;  // Nonzero for hash-consed ground types; see Interning
 }
 
 /**
@@ -66,6 +106,7 @@ export interface TypeRecord {
 export interface TypeList {
   kind: 'TypeList';
   elementType: Type;
+  internId: number;  // Nonzero for hash-consed ground types; see Interning
 }
 
 /**
@@ -75,33 +116,189 @@ export interface TypeApp {
   kind: 'TypeApp';
   constructor: string;
   args: Type[];
+  internId: number;  // Nonzero for hash-consed ground types; see Interning
+}
+
+// ============================================================================
+// Interning
+// ============================================================================
+
+// Types without unbound type variables are hash-consed: the constructors
+// below return one shared instance per distinct ground type, so equal
+// ground types can be recognized by identity.
+
+// Interned types other than constants, bucketed by a hash of their kind and
+// the intern ids of their parts; parts are themselves interned, so matching
+// a bucket entry takes one identity comparison per part. Cleared for each
+// program checked so it cannot grow without bound. Ids are never reused,
+// so entries built from parts interned before a clear never match.
+const internTable = new Map<number, Type[]>();
+
+// Constants are few and live for the whole process
+const typeConsts = new Map<string, TypeConst>();
+
+// Small ids for field and constructor names, to hash them without
+// rehashing the string
+const nameIds = new Map<string, number>();
+
+const NO_TYPES: Type[] = [];
+
+let internCounter = 0;
+
+function nameId(name: string): number {
+  let id = nameIds.get(name);
+  if (id === undefined) {
+    id = nameIds.size + 1;
+    nameIds.set(name, id);
+  }
+  return id;
+}
+
+function mix(hash: number, value: number): number {
+  return Math.imul(hash ^ value, 0x01000193);
+}
+
+/**
+ * Intern id of a type's representative, or 0 if it is not ground
+ */
+function groundId(type: Type): number {
+  type = prune(type);
+  return type.kind === 'TypeVar' ? 0 : type.internId;
+}
+
+function addInterned<T extends Type>(hash: number, type: T): T {
+  const bucket = internTable.get(hash);
+  if (bucket) {
+    bucket.push(type);
+  } else {
+    internTable.set(hash, [type]);
+  }
+  return type;
+}
+
+/**
+ * Whether a type is known to contain no type variables, so walks looking
+ * for variables can stop at it
+ */
+export function isGround(type: Type): boolean {
+  return type.kind !== 'TypeVar' && type.internId !== 0;
 }
 
 // ============================================================================
 // Built-in Types
 // ============================================================================
 
-export const TYPE_INT: TypeConst = { kind: 'TypeConst', name: 'Int' };
-export const TYPE_FLOAT: TypeConst = { kind: 'TypeConst', name: 'Float' };
-export const TYPE_STRING: TypeConst = { kind: 'TypeConst', name: 'String' };
-export const TYPE_CHAR: TypeConst = { kind: 'TypeConst', name: 'Char' };
-export const TYPE_BOOL: TypeConst = { kind: 'TypeConst', name: 'Bool' };
-export const TYPE_UNIT: TypeConst = { kind: 'TypeConst', name: 'Unit' };
+export function createTypeConst(name: string): TypeConst {
+  let type = typeConsts.get(name);
+  if (!type) {
+    type = { kind: 'TypeConst', name, internId: ++internCounter };
+    typeConsts.set(name, type);
+  }
+  return type;
+}
+
+export const TYPE_INT = createTypeConst('Int');
+export const TYPE_FLOAT = createTypeConst('Float');
+export const TYPE_STRING = createTypeConst('String');
+export const TYPE_CHAR = createTypeConst('Char');
+export const TYPE_BOOL = createTypeConst('Bool');
+export const TYPE_UNIT = createTypeConst('Unit');
 
 export function createFuncType(params: Type[], returnType: Type): TypeFunc {
-  return { kind: 'TypeFunc', params, returnType };
+  let hash = 1;
+  for (const param of params) {
+    const id = groundId(param);
+    if (id === 0) return { kind: 'TypeFunc', params, returnType, internId: 0 };
+    hash = mix(hash, id);
+  }
+  const returnId = groundId(returnType);
+  if (returnId === 0) return { kind: 'TypeFunc', params, returnType, internId: 0 };
+  hash = mix(hash, returnId);
+
+  search: for (const type of internTable.get(hash) ?? NO_TYPES) {
+    if (type.kind !== 'TypeFunc' || type.params.length !== params.length) continue;
+    if (type.returnType !== prune(returnType)) continue;
+    for (let i = 0; i < params.length; i++) {
+      if (type.params[i] !== prune(params[i]!)) continue search;
+    }
+    return type;
+  }
+
+  return addInterned(hash, {
+    kind: 'TypeFunc',
+    params: params.map(prune),
+    returnType: prune(returnType),
+    internId: ++internCounter,
+  });
 }
 
 export function createRecordType(fields: Map<string, Type>, isOpen = false): TypeRecord {
-  return { kind: 'TypeRecord', fields, isOpen };
+  // Field order is part of the identity, so records differing only in
+  // order are not shared; that costs a missed fast path, never correctness
+  let hash = isOpen ? 2 : 3;
+  for (const [name, fieldType] of fields) {
+    const id = groundId(fieldType);
+    if (id === 0) return { kind: 'TypeRecord', fields, isOpen, internId: 0 };
+    hash = mix(mix(hash, nameId(name)), id);
+  }
+
+  search: for (const type of internTable.get(hash) ?? NO_TYPES) {
+    if (type.kind !== 'TypeRecord' || type.isOpen !== isOpen) continue;
+    if (type.fields.size !== fields.size) continue;
+    const entries = type.fields.entries();
+    for (const [name, fieldType] of fields) {
+      const [internedName, internedType] = entries.next().value!;
+      if (internedName !== name || internedType !== prune(fieldType)) continue search;
+    }
+    return type;
+  }
+
+  const pruned = new Map<string, Type>();
+  for (const [name, fieldType] of fields) {
+    pruned.set(name, prune(fieldType));
+  }
+  return addInterned(hash, { kind: 'TypeRecord', fields: pruned, isOpen, internId: ++internCounter });
 }
 
 export function createListType(elementType: Type): TypeList {
-  return { kind: 'TypeList', elementType };
+  const id = groundId(elementType);
+  if (id === 0) return { kind: 'TypeList', elementType, internId: 0 };
+  const hash = mix(4, id);
+
+  for (const type of internTable.get(hash) ?? NO_TYPES) {
+    if (type.kind === 'TypeList' && type.elementType === prune(elementType)) return type;
+  }
+
+  return addInterned(hash, {
+    kind: 'TypeList',
+    elementType: prune(elementType),
+    internId: ++internCounter,
+  });
 }
 
 export function createTypeApp(constructor: string, args: Type[]): TypeApp {
-  return { kind: 'TypeApp', constructor, args };
+  let hash = mix(5, nameId(constructor));
+  for (const arg of args) {
+    const id = groundId(arg);
+    if (id === 0) return { kind: 'TypeApp', constructor, args, internId: 0 };
+    hash = mix(hash, id);
+  }
+
+  search: for (const type of internTable.get(hash) ?? NO_TYPES) {
+    if (type.kind !== 'TypeApp' || type.constructor !== constructor) continue;
+    if (type.args.length !== args.length) continue;
+    for (let i = 0; i < args.length; i++) {
+      if (type.args[i] !== prune(args[i]!)) continue search;
+    }
+    return type;
+  }
+
+  return addInterned(hash, {
+    kind: 'TypeApp',
+    constructor,
+    args: args.map(prune),
+    internId: ++internCounter,
+  });
 }
 
 // ============================================================================
@@ -109,46 +306,125 @@ export function createTypeApp(constructor: string, args: Type[]): TypeApp {
 // ============================================================================
 
 /**
- * Resolve a type variable chain to find the actual type
+ * Resolve a type variable chain to find the actual type, compressing the
+ * path so later lookups take one step
  */
 export function prune(type: Type): Type {
-  if (type.kind === 'TypeVar' && type.instance !== null) {
-    type.instance = prune(type.instance);
-    return type.instance;
+  let root = type;
+  while (root.kind === 'TypeVar' && root.instance !== null) {
+    root = root.instance;
   }
-  return type;
+
+  while (type !== root && type.kind === 'TypeVar') {
+    const next: Type = type.instance!;
+    type.instance = root;
+    type = next;
+  }
+  return root;
 }
 
 /**
- * Check if a type variable occurs in a type (for occurs check)
+ * Merge two distinct unbound type variables, attaching the shallower tree
+ * under the deeper one
  */
-export function occursIn(typeVar: TypeVar, type: Type): boolean {
-  type = prune(type);
-  
-  if (type.kind === 'TypeVar') {
-    return type.id === typeVar.id;
+export function unionTypeVars(a: TypeVar, b: TypeVar): void {
+  if (a.rank < b.rank) {
+    [a, b] = [b, a];
   }
-  
-  if (type.kind === 'TypeFunc') {
-    return type.params.some(p => occursIn(typeVar, p)) || occursIn(typeVar, type.returnType);
+  b.instance = a;
+  if (a.rank === b.rank) {
+    a.rank++;
   }
-  
-  if (type.kind === 'TypeRecord') {
-    for (const fieldType of type.fields.values()) {
-      if (occursIn(typeVar, fieldType)) return true;
-    }
+  a.level = Math.min(a.level, b.level);
+}
+
+/**
+ * Bind an unbound type variable to a type that is not a variable. Fails,
+ * leaving the variable unbound, if the variable occurs in the type.
+ *
+ * Variables in the type become reachable wherever the bound variable is,
+ * so their levels are lowered to its level in the same pass as the
+ * occurs check.
+ */
+export function bindTypeVar(typeVar: TypeVar, type: Type): boolean {
+  if (!adjustLevels(typeVar, type)) {
     return false;
   }
-  
-  if (type.kind === 'TypeList') {
-    return occursIn(typeVar, type.elementType);
+  typeVar.instance = type;
+  return true;
+}
+
+function adjustLevels(typeVar: TypeVar, type: Type): boolean {
+  type = prune(type);
+  if (isGround(type)) return true;
+
+  switch (type.kind) {
+    case 'TypeVar':
+      if (type === typeVar) return false;
+      if (type.level > typeVar.level) type.level = typeVar.level;
+      return true;
+
+    case 'TypeConst':
+      return true;
+
+    case 'TypeFunc':
+      for (const param of type.params) {
+        if (!adjustLevels(typeVar, param)) return false;
+      }
+      return adjustLevels(typeVar, type.returnType);
+
+    case 'TypeRecord':
+      for (const fieldType of type.fields.values()) {
+        if (!adjustLevels(typeVar, fieldType)) return false;
+      }
+      return true;
+
+    case 'TypeList':
+      return adjustLevels(typeVar, type.elementType);
+
+    case 'TypeApp':
+      for (const arg of type.args) {
+        if (!adjustLevels(typeVar, arg)) return false;
+      }
+      return true;
   }
-  
-  if (type.kind === 'TypeApp') {
-    return type.args.some(arg => occursIn(typeVar, arg));
+}
+
+/**
+ * Check if a type variable occurs in a type (for occurs check)
+ */
+export function occursIn(typeVar: TypeVar, type: Type): boolean {
+  type = prune(type);
+  if (isGround(type)) return false;
+
+  switch (type.kind) {
+    case 'TypeVar':
+      return type === typeVar;
+
+    case 'TypeConst':
+      return false;
+
+    case 'TypeFunc':
+      for (const param of type.params) {
+        if (occursIn(typeVar, param)) return true;
+      }
+      return occursIn(typeVar, type.returnType);
+
+    case 'TypeRecord':
+      for (const fieldType of type.fields.values()) {
+        if (occursIn(typeVar, fieldType)) return true;
+      }
+      return false;
+
+    case 'TypeList':
+      return occursIn(typeVar, type.elementType);
+
+    case 'TypeApp':
+      for (const arg of type.args) {
+        if (occursIn(typeVar, arg)) return true;
+      }
+      return false;
   }
-  
-  return false;
 }
 
 /**
@@ -197,6 +473,7 @@ export function typesEqual(a: Type, b: Type): boolean {
   a = prune(a);
   b = prune(b);
   
+  if (a === b) return true;
   if (a.kind !== b.kind) return false;
   
   switch (a.kind) {
@@ -236,20 +513,16 @@ export function typesEqual(a: Type, b: Type): boolean {
 }
 
 /**
- * Deep copy a type (for instantiation of polymorphic types)
+ * Deep copy a type (for instantiation of polymorphic types). Variables in
+ * `mapping` are replaced; all others are shared with the original.
  */
 export function copyType(type: Type, mapping: Map<number, TypeVar> = new Map()): Type {
   type = prune(type);
+  if (isGround(type)) return type;
   
   switch (type.kind) {
-    case 'TypeVar': {
-      let copy = mapping.get(type.id);
-      if (!copy) {
-        copy = freshTypeVar();
-        mapping.set(type.id, copy);
-      }
-      return copy;
-    }
+    case 'TypeVar':
+      return mapping.get(type.id) ?? type;
     
     case 'TypeConst':
       return type;
@@ -304,20 +577,47 @@ export function instantiate(scheme: TypeScheme): Type {
 }
 
 /**
- * Generalize a type into a type scheme
+ * Generalize a type into a type scheme, quantifying the variables created
+ * inside the binding being left (those above the current level)
  */
-export function generalize(type: Type, envTypeVars: Set<number>): TypeScheme {
-  const freeVars = freeTypeVars(type);
-  const quantified = [...freeVars].filter(id => !envTypeVars.has(id));
-  return createScheme(quantified, type);
+export function generalize(type: Type): TypeScheme {
+  const quantified = new Set<number>();
+
+  const visit = (t: Type): void => {
+    t = prune(t);
+    if (isGround(t)) return;
+    switch (t.kind) {
+      case 'TypeVar':
+        if (t.level > currentLevel) quantified.add(t.id);
+        break;
+      case 'TypeConst':
+        break;
+      case 'TypeFunc':
+        t.params.forEach(visit);
+        visit(t.returnType);
+        break;
+      case 'TypeRecord':
+        t.fields.forEach(visit);
+        break;
+      case 'TypeList':
+        visit(t.elementType);
+        break;
+      case 'TypeApp':
+        t.args.forEach(visit);
+        break;
+    }
+  };
+
+  visit(type);
+  return createScheme([...quantified], type);
 }
 
 /**
  * Get all free type variables in a type
  */
-export function freeTypeVars(type: Type): Set<number> {
+export function freeTypeVars(type: Type, vars: Set<number> = new Set()): Set<number> {
   type = prune(type);
-  const vars = new Set<number>();
+  if (isGround(type)) return vars;
   
   switch (type.kind) {
     case 'TypeVar':
@@ -326,24 +626,24 @@ export function freeTypeVars(type: Type): Set<number> {
     
     case 'TypeFunc':
       for (const p of type.params) {
-        for (const v of freeTypeVars(p)) vars.add(v);
+        freeTypeVars(p, vars);
       }
-      for (const v of freeTypeVars(type.returnType)) vars.add(v);
+      freeTypeVars(type.returnType, vars);
       break;
     
     case 'TypeRecord':
       for (const fieldType of type.fields.values()) {
-        for (const v of freeTypeVars(fieldType)) vars.add(v);
+        freeTypeVars(fieldType, vars);
       }
       break;
     
     case 'TypeList':
-      for (const v of freeTypeVars(type.elementType)) vars.add(v);
+      freeTypeVars(type.elementType, vars);
       break;
     
     case 'TypeApp':
       for (const arg of type.args) {
-        for (const v of freeTypeVars(arg)) vars.add(v);
+        freeTypeVars(arg, vars);
       }
       break;
   }
@@ -351,3 +651,120 @@ export function freeTypeVars(type: Type): Set<number> {
   return vars;
 }
 
+// ============================================================================
+// Scheme Serialization (for the compilation cache)
+// ============================================================================
+
+/**
+ * JSON-safe form of a type; type variables are numbered by first occurrence
+ */
+export type SerializedType =
+  | { kind: 'TypeVar'; index: number }
+  | { kind: 'TypeConst'; name: string }
+  | { kind: 'TypeFunc'; params: SerializedType[]; returnType: SerializedType }
+  | { kind: 'TypeRecord'; fields: [string, SerializedType][]; isOpen: boolean }
+  | { kind: 'TypeList'; elementType: SerializedType }
+  | { kind: 'TypeApp'; constructor: string; args: SerializedType[] };
+
+export interface SerializedScheme {
+  /** Number of quantified type variables */
+  typeVars: number;
+  type: SerializedType;
+}
+
+/**
+ * Convert a scheme to JSON-safe form. Returns null if the scheme has free
+ * type variables that are not quantified, since those cannot be detached
+ * from the environment they were inferred in.
+ */
+export function serializeScheme(scheme: TypeScheme): SerializedScheme | null {
+  const indices = new Map<number, number>();
+  for (const id of scheme.typeVars) {
+    indices.set(id, indices.size);
+  }
+
+  const serialize = (type: Type): SerializedType | null => {
+    type = prune(type);
+
+    switch (type.kind) {
+      case 'TypeVar': {
+        const index = indices.get(type.id);
+        return index === undefined ? null : { kind: 'TypeVar', index };
+      }
+
+      case 'TypeConst':
+        return { kind: 'TypeConst', name: type.name };
+
+      case 'TypeFunc': {
+        const params: SerializedType[] = [];
+        for (const p of type.params) {
+          const param = serialize(p);
+          if (!param) return null;
+          params.push(param);
+        }
+        const returnType = serialize(type.returnType);
+        return returnType ? { kind: 'TypeFunc', params, returnType } : null;
+      }
+
+      case 'TypeRecord': {
+        const fields: [string, SerializedType][] = [];
+        for (const [name, fieldType] of type.fields) {
+          const field = serialize(fieldType);
+          if (!field) return null;
+          fields.push([name, field]);
+        }
+        return { kind: 'TypeRecord', fields, isOpen: type.isOpen };
+      }
+
+      case 'TypeList': {
+        const elementType = serialize(type.elementType);
+        return elementType ? { kind: 'TypeList', elementType } : null;
+      }
+
+      case 'TypeApp': {
+        const args: SerializedType[] = [];
+        for (const a of type.args) {
+          const arg = serialize(a);
+          if (!arg) return null;
+          args.push(arg);
+        }
+        return { kind: 'TypeApp', constructor: type.constructor, args };
+      }
+    }
+  };
+
+  const type = serialize(scheme.type);
+  return type ? { typeVars: indices.size, type } : null;
+}
+
+/**
+ * Rebuild a scheme from its serialized form with fresh type variables
+ */
+export function deserializeScheme(serialized: SerializedScheme): TypeScheme {
+  const vars: TypeVar[] = [];
+  for (let i = 0; i < serialized.typeVars; i++) {
+    vars.push(freshTypeVar());
+  }
+
+  const deserialize = (type: SerializedType): Type => {
+    switch (type.kind) {
+      case 'TypeVar':
+        return vars[type.index]!;
+      case 'TypeConst':
+        return createTypeConst(type.name);
+      case 'TypeFunc':
+        return createFuncType(type.params.map(deserialize), deserialize(type.returnType));
+      case 'TypeRecord':
+        return createRecordType(
+          new Map(type.fields.map(([name, t]) => [name, deserialize(t)])),
+          type.isOpen
+        );
+      case 'TypeList':
+        return createListType(deserialize(type.elementType));
+      case 'TypeApp':
+        return createTypeApp(type.constructor, type.args.map(deserialize));
+    }
+  };
+
+  return createScheme(vars.map(v => v.id), deserialize(serialized.type));
+}